@@ -0,0 +1,202 @@
+#include "analyse.h"
+#include "misc.h"
+#include "numa.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// EPD lines carry the first 4 FEN fields, optionally the two clocks, and then
+// opcodes like "bm e4;". Missing clocks default to "0 1".
+std::string epd_to_fen(const std::string &line) {
+    std::istringstream is(line);
+    std::string fields[6];
+    int count = 0;
+
+    while (count < 6 && is >> fields[count]) {
+        const bool numeric = std::all_of(fields[count].begin(), fields[count].end(),
+                                         [](unsigned char c) { return std::isdigit(c); });
+        if (count >= 4 && !numeric)
+            break;
+        count++;
+    }
+
+    // skip lines that can't be a position, the board parser does no validation
+    if (count < 4 || std::count(fields[0].begin(), fields[0].end(), '/') != 7 ||
+        std::count(fields[0].begin(), fields[0].end(), 'K') != 1 ||
+        std::count(fields[0].begin(), fields[0].end(), 'k') != 1 || (fields[1] != "w" && fields[1] != "b"))
+        return "";
+
+    std::string fen = fields[0] + " " + fields[1] + " " + fields[2] + " " + fields[3];
+    fen += " " + (count > 4 ? fields[4] : std::string("0"));
+    fen += " " + (count > 5 ? fields[5] : std::string("1"));
+
+    return fen;
+}
+
+} // namespace
+
+bool ParseAnalyseOptions(int argc, char **argv, AnalyseOptions &options) {
+    if (argc < 2)
+        return false;
+
+    options.input = argv[1];
+
+    bool depth_given = false;
+
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (arg == "--private-tt") {
+            options.private_tt = true;
+            continue;
+        }
+
+        if (arg == "--keep-history") {
+            options.keep_history = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+
+        if (arg == "--depth") {
+            options.depth = std::clamp(std::stoi(value), 1, MAXPLY);
+            depth_given = true;
+        } else if (arg == "--nodes")
+            options.nodes = std::stoull(value);
+        else if (arg == "--threads")
+            options.threads = std::max(1, std::stoi(value));
+        else if (arg == "--hash")
+            options.hash = std::max(1, std::stoi(value));
+        else if (arg == "--out")
+            options.output = value;
+        else
+            return false;
+    }
+
+    if (options.output.empty())
+        options.output = options.input + ".csv";
+
+    // a node limit alone searches as deep as the nodes allow
+    if (options.nodes && !depth_given)
+        options.depth = MAXPLY;
+
+    return true;
+}
+
+void StartAnalysis(const AnalyseOptions &options) {
+    std::ifstream in(options.input);
+    if (!in) {
+        std::cout << "Could not open " << options.input << std::endl;
+        return;
+    }
+
+    std::vector<std::string> fens;
+    for (std::string line; std::getline(in, line);) {
+        std::string fen = epd_to_fen(line);
+        if (!fen.empty())
+            fens.push_back(std::move(fen));
+    }
+
+    std::ofstream out(options.output);
+    if (!out) {
+        std::cout << "Could not open " << options.output << std::endl;
+        return;
+    }
+
+    out << "fen,score,bestmove,nodes\n";
+
+    if (!options.private_tt) {
+        table->Initialize(options.hash, options.threads);
+    }
+
+    std::atomic<size_t> next_position = 0;
+    std::atomic<uint64_t> total_nodes = 0;
+    std::mutex out_mutex;
+
+    auto worker = [&](int id) {
+        // before anything is allocated, so the worker's state is local to its node
+        Numa::bind_thread(id, options.threads);
+
+        SearchInfo info;
+        info.depth = options.depth;
+        info.timeset = false;
+        info.nodeset = options.nodes != 0;
+        info.nodes = options.nodes;
+        info.age_tt = options.private_tt;
+
+        auto st = std::make_unique<SearchThread>(info);
+
+        std::unique_ptr<TranspositionTable> own_table;
+        if (options.private_tt) {
+            own_table = std::make_unique<TranspositionTable>();
+            own_table->Initialize(options.hash);
+            st->tt = own_table.get();
+        }
+
+        std::string lines;
+        int pending = 0;
+
+        auto flush = [&]() {
+            std::lock_guard lock(out_mutex);
+            out << lines;
+            lines.clear();
+            pending = 0;
+        };
+
+        for (size_t i = next_position++; i < fens.size(); i = next_position++) {
+            st->applyFen(fens[i]);
+
+            // every position starts from fresh histories unless asked otherwise,
+            // clearing costs over a MB of memsets at the low limits used here
+            if (!options.keep_history)
+                st->clear();
+
+            info.stopped = false;
+            iterative_deepening<false>(*st);
+
+            total_nodes += st->nodes_reached;
+
+            // mated or stalemated positions have no move, only their mate or draw score
+            const std::string move = st->completed_move == NO_MOVE ? "0000" : convertMoveToUci(st->completed_move);
+
+            lines += fens[i] + "," + std::to_string(st->completed_score) + "," + move + "," +
+                     std::to_string(st->nodes_reached) + "\n";
+
+            if (++pending == 64)
+                flush();
+        }
+
+        flush();
+    };
+
+    auto start = misc::tick();
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < options.threads; i++)
+        pool.emplace_back(worker, i);
+
+    worker(0);
+
+    for (auto &th : pool)
+        th.join();
+
+    auto elapsed = misc::tick() - start;
+
+    printf("Analysed %zu positions in %.2f s, %.1f positions/s, %llu nodes, %llu nps\n", fens.size(),
+           elapsed / 1000.0, 1000.0 * fens.size() / (elapsed + 1),
+           static_cast<unsigned long long>(total_nodes.load()),
+           static_cast<unsigned long long>(1000.0 * total_nodes / (elapsed + 1)));
+    std::cout << std::flush;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "search.h"
+
+#include <string>
+
+struct AnalyseOptions {
+    std::string input;
+    std::string output; // <input>.csv unless given
+
+    int depth = 10;
+    uint64_t nodes = 0; // 0 means no node limit
+    int threads = 1;
+    int hash = 16; // MB, for every worker when the tables are private
+
+    bool private_tt = false;
+
+    // Keep the histories from one position to the next instead of zeroing them.
+    // Faster at low limits, but the continuation and correction tables of
+    // unrelated positions then carry over unaged.
+    bool keep_history = false;
+};
+
+/// @brief parses `analyse <file.epd> [--depth N] [--nodes N] [--threads T] [--hash H] [--private-tt]
+/// [--keep-history] [--out file]`
+/// @return false on malformed arguments
+bool ParseAnalyseOptions(int argc, char **argv, AnalyseOptions &options);
+
+/// @brief searches every position of an EPD file, each worker owns a SearchThread and
+/// pulls the next position from a shared counter. Writes fen,score,bestmove,nodes CSV lines.
+void StartAnalysis(const AnalyseOptions &options);
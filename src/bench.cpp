@@ -1,36 +1,148 @@
 #include "bench.h"
 #include "misc.h"
+#include "thread.h"
 
-void StartBenchmark(SearchThread& st) {
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+BenchOptions ParseBenchOptions(std::istream& is) {
+    BenchOptions options;
+
+    int* numbers[] = {&options.depth, &options.threads, &options.hash};
+    size_t next = 0;
+
+    std::string token;
+    while (is >> token) {
+        if (token == "json") {
+            options.json = true;
+        } else if (next < 3 && std::all_of(token.begin(), token.end(), [](unsigned char c) { return std::isdigit(c); })) {
+            *numbers[next++] = std::stoi(token);
+        } else {
+            options.fen_file = token;
+        }
+    }
+
+    options.depth   = std::clamp(options.depth, 1, MAXPLY);
+    options.threads = std::clamp(options.threads, 1, MAXTHREADS);
+    options.hash    = std::clamp(options.hash, 0, MAXHASH);
+
+    return options;
+}
+
+static double percent(uint64_t part, uint64_t total) {
+    return total ? 100.0 * part / total : 0.0;
+}
+
+void StartBenchmark(SearchThread& st, const BenchOptions& options) {
     SearchInfo& info = st.info;
 
-    info.depth            = 13;
-    info.timeset          = false;
+    std::vector<std::string> fens(bench_fens.begin(), bench_fens.end());
+
+    if (!options.fen_file.empty()) {
+        std::ifstream file(options.fen_file);
+        if (!file) {
+            std::cout << "Could not open " << options.fen_file << std::endl;
+            return;
+        }
+
+        fens.clear();
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty()) {
+                fens.push_back(line);
+            }
+        }
+    }
+
+    if (options.hash) {
+        table->Initialize(options.hash, options.threads);
+    }
+
+    // Every run starts from an empty table so the signature only depends on the options
+    table->clear(options.threads);
+
+    ThreadHandler threads;
+    threads.resize(options.threads);
 
     uint64_t nodes        = 0;
     uint64_t count        = 0;
+    uint64_t tt_probes    = 0;
+    uint64_t tt_hits      = 0;
     uint64_t time_elapsed = 0;
 
+    SearchStats stats;
+
+    std::ostringstream json;
+
+    if (!options.json) {
+        std::cout << "Sliders: " << Chess_Lookup::Sliders::Backend << std::endl;
+    }
+
     // Inspired from Koivisto
 
-    for (auto& fen : bench_fens) {
+    for (auto& fen : fens) {
         st.applyFen(fen);
+        st.clear();
+        threads.clear();
+
+        info.depth   = options.depth;
+        info.timeset = false;
+        info.nodeset = false;
+        info.stopped = false;
+        info.ponder  = false;
 
         auto start = misc::tick();
-        iterative_deepening<false>(st);
+        threads.start(st, false);
+        threads.stop();
         auto end = misc::tick();
 
+        const uint64_t position_nodes  = threads.sum(&SearchThread::nodes_reached);
+        const uint64_t position_probes = threads.sum(&SearchThread::tt_probes);
+        const uint64_t position_hits   = threads.sum(&SearchThread::tt_hits);
+        const uint64_t position_time   = end - start;
+
         count++;
-        nodes += st.nodes_reached;
-        time_elapsed += (end - start);
+        nodes += position_nodes;
+        tt_probes += position_probes;
+        tt_hits += position_hits;
+        time_elapsed += position_time;
+        stats += threads.stats();
 
-        printf("Position [%2d] -> cp %5d bestmove %s %12ld nodes %8d nps", int(count),
-               int(info.score), convertMoveToUci(st.bestmove).c_str(), nodes,
-               static_cast<int>(1000.0f * nodes / (time_elapsed + 1)));
-        std::cout << std::endl;
+        const uint64_t nps = 1000.0 * position_nodes / (position_time + 1);
+
+        if (options.json) {
+            json << (count > 1 ? "," : "") << "{\"fen\":\"" << fen << "\",\"score\":" << info.score
+                 << ",\"bestmove\":\"" << convertMoveToUci(info.bestmove) << "\",\"nodes\":" << position_nodes
+                 << ",\"time_ms\":" << position_time << ",\"nps\":" << nps
+                 << ",\"tt_hit_rate\":" << percent(position_hits, position_probes) << "}";
+            continue;
+        }
+
+        printf("Position [%2d] -> cp %5d bestmove %-5s %12llu nodes %9llu nps %7llu ms %5.1f%% tt hits\n",
+               int(count), int(info.score), convertMoveToUci(info.bestmove).c_str(),
+               static_cast<unsigned long long>(position_nodes), static_cast<unsigned long long>(nps),
+               static_cast<unsigned long long>(position_time), percent(position_hits, position_probes));
     }
 
-    printf("Finished: %42d nodes %8d nps\n", static_cast<int>(nodes),
-           static_cast<int>(1000.0f * nodes / (time_elapsed + 1)));
+    const uint64_t nps = 1000.0 * nodes / (time_elapsed + 1);
+
+    if (options.json) {
+        std::cout << "{\"depth\":" << options.depth << ",\"threads\":" << options.threads
+                  << ",\"hash\":" << table->size_mb() << ",\"sliders\":\"" << Chess_Lookup::Sliders::Backend
+                  << "\",\"positions\":[" << json.str() << "],\"nodes\":" << nodes << ",\"time_ms\":" << time_elapsed
+                  << ",\"nps\":" << nps << ",\"tt_hit_rate\":" << percent(tt_hits, tt_probes) << "}" << std::endl;
+        return;
+    }
+
+    printf("Depth %d Threads %d Hash %d MB: %llu ms to depth, %.1f%% tt hits\n", options.depth, options.threads,
+           table->size_mb(), static_cast<unsigned long long>(time_elapsed), percent(tt_hits, tt_probes));
+    printf("Finished: %42llu nodes %8llu nps\n", static_cast<unsigned long long>(nodes),
+           static_cast<unsigned long long>(nps));
+
+    if constexpr (SearchStatsEnabled) {
+        PrintSearchStats(stats, nodes, tt_probes, tt_hits);
+    }
     std::cout << std::flush;
-}
\ No newline at end of file
+}
@@ -1,5 +1,10 @@
+#pragma once
+
 #include "search.h"
 
+#include <istream>
+#include <string>
+
 const std::array<std::string, 50> bench_fens = {
     "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
     "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
@@ -52,4 +57,17 @@ const std::array<std::string, 50> bench_fens = {
     "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
     "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93",
 };
-void StartBenchmark(SearchThread& st);
\ No newline at end of file
+
+struct BenchOptions {
+    int depth = 13;
+    int threads = 1;
+    int hash = 0; // MB, 0 keeps the current table
+    std::string fen_file; // one FEN per line instead of bench_fens
+    bool json = false;
+};
+
+/// @brief parses `[depth] [threads] [hash] [fenfile] [json]`, numbers fill depth,
+/// threads and hash in that order
+BenchOptions ParseBenchOptions(std::istream& is);
+
+void StartBenchmark(SearchThread& st, const BenchOptions& options = {});
@@ -6,19 +6,14 @@ template void Board::makeMove<false>(Move, NNUE::Net&);
 template void Board::makeMove<true>(Move, NNUE::Net&);
 template void Board::unmakeMove<true>(Move, NNUE::Net&);
 template void Board::unmakeMove<false>(Move, NNUE::Net&);
-template void Board::placePiece<false>(Piece piece, Square, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
-template void Board::placePiece<true>(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
-template void Board::removePiece<false>(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
-template void Board::removePiece<true>(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
-template void Board::movePiece<false>(Piece piece, Square fromSq, Square toSq, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
-template void Board::movePiece<true>(Piece piece, Square fromSq, Square toSq, Square kSQ_White, Square kSQ_Black, NNUE::Net&);
+template void Board::placePiece<false>(Piece piece, Square, NNUE::Net&);
+template void Board::placePiece<true>(Piece piece, Square sq, NNUE::Net&);
+template void Board::removePiece<false>(Piece piece, Square sq, NNUE::Net&);
+template void Board::removePiece<true>(Piece piece, Square sq, NNUE::Net&);
+template void Board::movePiece<false>(Piece piece, Square fromSq, Square toSq, NNUE::Net&);
+template void Board::movePiece<true>(Piece piece, Square fromSq, Square toSq, NNUE::Net&);
 
 Board::Board(std::string fen, NNUE::Net& nnue) {
-    initializeLookupTables();
-    stateHistory.reserve(MAX_PLY);
-    hashHistory.reserve(512);
-    pawnKeyHistory.reserve(512);
-
     sideToMove = White;
     enPassantSquare = NO_SQ;
     castlingRights = wk | wq | bk | bq;
@@ -108,15 +103,32 @@ void Board::applyFen(const std::string &fen, NNUE::Net& nnue) {
     pawnKeyHistory.clear();
     stateHistory.clear();
 
-    hashHistory.push_back(hashKey);
-    pawnKeyHistory.push_back(pawnKey);
+    hashHistory.push(hashKey);
+    pawnKeyHistory.push(pawnKey);
+
+    updateCheckers();
 
-    refresh(nnue);
     nnue.reset_accumulators();
+    refresh(nnue);
 }
 
 void Board::refresh(NNUE::Net& nnue) { nnue.refresh(*this); }
 
+void Board::updateCheckers() {
+    checkersBB = attackersForSide(~sideToMove, KingSQ(sideToMove), All());
+    masksReady = false;
+}
+
+void Board::trimHistory() {
+    // repetitions can only reach back to the last irreversible move, past
+    // MAX_GAME_PLY plies the game is drawn by the 50 move rule anyway
+    const int keep = std::min(halfMoveClock + 1, MAX_GAME_PLY);
+
+    hashHistory.keep(keep);
+    pawnKeyHistory.keep(keep);
+    stateHistory.keep(keep);
+}
+
 template <bool updateNNUE> void Board::makeMove(Move move, NNUE::Net& nnue) {
     PieceType pt = piece(move);
     Piece p = makePiece(pt, sideToMove);
@@ -134,9 +146,9 @@ template <bool updateNNUE> void Board::makeMove(Move move, NNUE::Net& nnue) {
     // STORE STATE HISTORY
     // *****************************
 
-    hashHistory.emplace_back(hashKey);
-    stateHistory.emplace_back(State(enPassantSquare, castlingRights, halfMoveClock, capture));
-    pawnKeyHistory.emplace_back(pawnKey);
+    hashHistory.push(hashKey);
+    stateHistory.push(State(enPassantSquare, castlingRights, halfMoveClock, capture, checkersBB));
+    pawnKeyHistory.push(pawnKey);
 
     if constexpr (updateNNUE) {
         nnue.push();
@@ -158,9 +170,6 @@ template <bool updateNNUE> void Board::makeMove(Move move, NNUE::Net& nnue) {
 
     hashKey ^= updateKeyCastling();
 
-    const Square kSQ_White = lsb(pieces<KING, White>());
-    const Square kSQ_Black = lsb(pieces<KING, Black>());
-
     if (isCastling) {
         Piece rook = sideToMove == White ? WhiteRook : BlackRook;
         Square rookSQ = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
@@ -227,27 +236,21 @@ template <bool updateNNUE> void Board::makeMove(Move move, NNUE::Net& nnue) {
         Square rookToSq = file_rank_square(to_sq > from_sq ? FILE_F : FILE_D, square_rank(from_sq));
         Square kingToSq = file_rank_square(to_sq > from_sq ? FILE_G : FILE_C, square_rank(from_sq));
 
-        if (updateNNUE && (NNUE::KING_BUCKET[from_sq ^ (static_cast<bool>(sideToMove) * 56)] != NNUE::KING_BUCKET[kingToSq ^ (static_cast<bool>(sideToMove) * 56)] ||
-            square_file(from_sq) + square_file(kingToSq) == 7)) {
-            removePiece(p, from_sq);
-            removePiece(rook, to_sq);
-
-            placePiece(p, kingToSq);
-            placePiece(rook, rookToSq);
+        removePiece<updateNNUE>(p, from_sq, nnue);
+        removePiece<updateNNUE>(rook, to_sq, nnue);
 
-            refresh(nnue);
-        } else {
-            removePiece<updateNNUE>(p, from_sq, kSQ_White, kSQ_Black, nnue);
-            removePiece<updateNNUE>(rook, to_sq, kSQ_White, kSQ_Black, nnue);
+        placePiece<updateNNUE>(p, kingToSq, nnue);
+        placePiece<updateNNUE>(rook, rookToSq, nnue);
 
-            placePiece<updateNNUE>(p, kingToSq, kSQ_White, kSQ_Black, nnue);
-            placePiece<updateNNUE>(rook, rookToSq, kSQ_White, kSQ_Black, nnue);
+        if (updateNNUE && (NNUE::KING_BUCKET[from_sq ^ (static_cast<bool>(sideToMove) * 56)] != NNUE::KING_BUCKET[kingToSq ^ (static_cast<bool>(sideToMove) * 56)] ||
+            square_file(from_sq) + square_file(kingToSq) == 7)) {
+            nnue.requestRefresh(sideToMove);
         }
 
     } else if (pt == PAWN && ep) {
         assert(pieceAtB(Square(to_sq ^ 8)) != None);
 
-        removePiece<updateNNUE>(makePiece(PAWN, ~sideToMove), Square(to_sq ^ 8), kSQ_White, kSQ_Black, nnue);
+        removePiece<updateNNUE>(makePiece(PAWN, ~sideToMove), Square(to_sq ^ 8), nnue);
 
     } else if (capture != None && !isCastling) {
         assert(pieceAtB(to_sq) != None);
@@ -256,32 +259,37 @@ template <bool updateNNUE> void Board::makeMove(Move move, NNUE::Net& nnue) {
             pawnKey ^= updateKeyPiece(capture, to_sq);
         }
 
-        removePiece<updateNNUE>(capture, to_sq, kSQ_White, kSQ_Black, nnue);
+        removePiece<updateNNUE>(capture, to_sq, nnue);
     }
 
     if (promoted(move)) {
         assert(pieceAtB(to_sq) == None);
 
-        removePiece<updateNNUE>(makePiece(PAWN, sideToMove), from_sq, kSQ_White, kSQ_Black, nnue);
-        placePiece<updateNNUE>(p, to_sq, kSQ_White, kSQ_Black, nnue);
+        removePiece<updateNNUE>(makePiece(PAWN, sideToMove), from_sq, nnue);
+        placePiece<updateNNUE>(p, to_sq, nnue);
 
     } else if (!isCastling) {
         assert(pieceAtB(to_sq) == None);
 
-        movePiece<updateNNUE>(p, from_sq, to_sq, kSQ_White, kSQ_Black, nnue);
+        movePiece<updateNNUE>(p, from_sq, to_sq, nnue);
     }
 
     sideToMove = ~sideToMove;
+
+    updateCheckers();
 }
 
 template <bool updateNNUE> void Board::unmakeMove(Move move, NNUE::Net& nnue) {
     const State restore = stateHistory.back();
-    stateHistory.pop_back();
+    stateHistory.pop();
 
     hashKey = hashHistory.back();
-    hashHistory.pop_back();
+    hashHistory.pop();
     pawnKey = pawnKeyHistory.back();
-    pawnKeyHistory.pop_back();
+    pawnKeyHistory.pop();
+
+    checkersBB = restore.checkers;
+    masksReady = false;
 
     if constexpr (updateNNUE) {
         nnue.pull();
@@ -336,9 +344,13 @@ template <bool updateNNUE> void Board::unmakeMove(Move move, NNUE::Net& nnue) {
 }
 
 void Board::makeNullMove() {
-    stateHistory.emplace_back(State(enPassantSquare, castlingRights, halfMoveClock, None));
+    stateHistory.push(State(enPassantSquare, castlingRights, halfMoveClock, None, checkersBB));
     sideToMove = ~sideToMove;
 
+    // the side that passed was not in check, so the side to move cannot be either
+    checkersBB = 0;
+    masksReady = false;
+
     hashKey ^= updateKeySideToMove();
     if (enPassantSquare != NO_SQ)
         hashKey ^= updateKeyEnPassant(enPassantSquare);
@@ -349,11 +361,13 @@ void Board::makeNullMove() {
 
 void Board::unmakeNullMove() {
     const State restore = stateHistory.back();
-    stateHistory.pop_back();
+    stateHistory.pop();
 
     enPassantSquare = restore.enPassant;
     castlingRights = restore.castling;
     halfMoveClock = restore.halfMove;
+    checkersBB = restore.checkers;
+    masksReady = false;
 
     hashKey ^= updateKeySideToMove();
     if (enPassantSquare != NO_SQ)
@@ -383,38 +397,37 @@ void Board::movePiece(Piece piece, Square fromSq, Square toSq) {
 /// @brief For efficient updates
 /// @param piece
 /// @param sq
-template <bool updateNNUE> void Board::removePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue) {
+template <bool updateNNUE> void Board::removePiece(Piece piece, Square sq, NNUE::Net& nnue) {
     piecesBB[piece] &= ~(1ULL << sq);
     board[sq] = None;
 
     if constexpr (updateNNUE) {
-        nnue.updateAccumulator<false>(type_of_piece(piece), piece < BlackPawn ? White : Black, sq, kSQ_White,
-                                       kSQ_Black);
+        nnue.removeFeature(piece, sq);
     }
 }
 
-template <bool updateNNUE> void Board::placePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue) {
+template <bool updateNNUE> void Board::placePiece(Piece piece, Square sq, NNUE::Net& nnue) {
     piecesBB[piece] |= (1ULL << sq);
     board[sq] = piece;
     if constexpr (updateNNUE) {
-        nnue.updateAccumulator<true>(type_of_piece(piece), piece < BlackPawn ? White : Black, sq, kSQ_White,
-                                      kSQ_Black);
+        nnue.addFeature(piece, sq);
     }
 }
 template <bool updateNNUE>
-void Board::movePiece(Piece piece, Square fromSq, Square toSq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue) {
+void Board::movePiece(Piece piece, Square fromSq, Square toSq, NNUE::Net& nnue) {
     piecesBB[piece] &= ~(1ULL << fromSq);
     piecesBB[piece] |= (1ULL << toSq);
     board[fromSq] = None;
     board[toSq] = piece;
 
     if constexpr (updateNNUE) {
+        nnue.removeFeature(piece, fromSq);
+        nnue.addFeature(piece, toSq);
+
+        // A king that changes bucket only invalidates its own perspective
         if (type_of_piece(piece) == KING && (NNUE::KING_BUCKET[fromSq ^ (static_cast<bool>(sideToMove) * 56)] != NNUE::KING_BUCKET[toSq ^ (static_cast<bool>(sideToMove) * 56)]||
             square_file(fromSq) + square_file(toSq) == 7)) {
-            refresh(nnue);
-        } else {
-            nnue.updateAccumulator(type_of_piece(piece), piece < BlackPawn ? White : Black, fromSq, toSq, kSQ_White,
-                                    kSQ_Black);
+            nnue.requestRefresh(sideToMove);
         }
     }
 }
\ No newline at end of file
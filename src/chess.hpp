@@ -21,7 +21,7 @@ namespace NNUE {
     struct Net;
 }
 
-using namespace Chess_Lookup::Fancy;
+using namespace Chess_Lookup::Sliders;
 
 namespace Chess {
 
@@ -103,6 +103,13 @@ const std::string squareToString[MAX_SQ] = {
 static constexpr int MAX_PLY = 120;
 static constexpr int MAX_MOVES = 128;
 
+// longest game prefix kept in the board history. Repetitions can't reach back
+// past the last irreversible move, which the 50 move rule puts at 100 plies, so
+// trimHistory() drops everything older after every game move. This keeps the
+// three history stacks, and with them every board copy, under 8 KB.
+static constexpr int MAX_GAME_PLY = 104;
+static constexpr int MAX_HISTORY = MAX_GAME_PLY + MAX_PLY;
+
 static constexpr U64 WK_CASTLE_MASK = (1ULL << SQ_F1) | (1ULL << SQ_G1);
 static constexpr U64 WQ_CASTLE_MASK = (1ULL << SQ_D1) | (1ULL << SQ_C1) | (1ULL << SQ_B1);
 
@@ -482,10 +489,45 @@ struct State {
     uint8_t castling{};
     uint8_t halfMove{};
     Piece capturedPiece = None;
+    U64 checkers{};
     State(Square enpassantCopy = {}, uint8_t castlingRightsCopy = {}, uint8_t halfMoveCopy = {},
-          Piece capturedPieceCopy = None)
+          Piece capturedPieceCopy = None, U64 checkersCopy = {})
         : enPassant(enpassantCopy), castling(castlingRightsCopy), halfMove(halfMoveCopy),
-          capturedPiece(capturedPieceCopy) {}
+          capturedPiece(capturedPieceCopy), checkers(checkersCopy) {}
+};
+
+/// @brief fixed capacity stack stored inline in the board, pushes and pops
+/// never allocate and are only bounds checked in debug builds
+template <typename T, int N> class HistoryStack {
+  public:
+    void push(const T &value) {
+        assert(count < N);
+        data[count++] = value;
+    }
+
+    void pop() {
+        assert(count > 0);
+        count--;
+    }
+
+    const T &back() const { return data[count - 1]; }
+    const T &operator[](int i) const { return data[i]; }
+
+    int size() const { return count; }
+    void clear() { count = 0; }
+
+    /// @brief keeps only the newest n entries
+    void keep(int n) {
+        n = std::min(n, N);
+        if (n >= count)
+            return;
+        std::copy(data.begin() + count - n, data.begin() + count, data.begin());
+        count = n;
+    }
+
+  private:
+    std::array<T, N> data;
+    int count = 0;
 };
 
 struct ExtMove {
@@ -696,6 +738,31 @@ inline U64 KnightAttacks(Square sq) { return KNIGHT_ATTACKS_TABLE[sq]; }
 
 inline U64 KingAttacks(Square sq) { return KING_ATTACKS_TABLE[sq]; }
 
+// Squares strictly between two squares that share a rank, file or diagonal,
+// empty otherwise. One table for the whole program, computed at compile time.
+inline constexpr auto SQUARES_BETWEEN_BB = [] {
+    std::array<std::array<U64, MAX_SQ>, MAX_SQ> between{};
+
+    for (int sq1 = 0; sq1 < MAX_SQ; sq1++) {
+        for (int sq2 = 0; sq2 < MAX_SQ; sq2++) {
+            const int file_delta = (sq2 & 7) - (sq1 & 7);
+            const int rank_delta = (sq2 >> 3) - (sq1 >> 3);
+
+            if (sq1 == sq2 || (file_delta != 0 && rank_delta != 0 && file_delta != rank_delta &&
+                               file_delta != -rank_delta))
+                continue;
+
+            const int step = (rank_delta > 0) - (rank_delta < 0);
+            const int direction = step * 8 + (file_delta > 0) - (file_delta < 0);
+
+            for (int sq = sq1 + direction; sq != sq2; sq += direction)
+                between[sq1][sq2] |= 1ULL << sq;
+        }
+    }
+
+    return between;
+}();
+
 class Board {
   public:
     Color sideToMove;
@@ -753,18 +820,25 @@ class Board {
     U64 occAll;
     U64 enemyEmptyBB;
 
-    U64 SQUARES_BETWEEN_BB[MAX_SQ][MAX_SQ];
+    // the masks above are only computed once per position, makeMove and
+    // unmakeMove mark them stale
+    bool masksReady = false;
 
   private:
+    // enemy pieces giving check to the side to move, set by makeMove
+    U64 checkersBB = 0;
+
+    void updateCheckers();
+
     // keeps track of previous hashes, used for
     // repetition detection
-    std::vector<U64> hashHistory;
-    std::vector<U64> pawnKeyHistory;
+    HistoryStack<U64, MAX_HISTORY> hashHistory;
+    HistoryStack<U64, MAX_HISTORY> pawnKeyHistory;
 
-    std::vector<State> stateHistory;
+    HistoryStack<State, MAX_HISTORY> stateHistory;
 
   public:
-    /// @brief constructor for the board, loads startpos and initializes SQUARES_BETWEEN_BB array
+    /// @brief constructor for the board, loads startpos
     Board(std::string fen, NNUE::Net& nnue);
 
     /// @brief Finds what piece is on the square using bitboards (slow)
@@ -795,6 +869,10 @@ class Board {
     /// @return true for repetition otherwise false
     bool isRepetition(int draw = 2) const;
 
+    /// @brief drops history older than the last irreversible move, call it after
+    /// every game move. Moves before that point can no longer be unmade.
+    void trimHistory();
+
     /// @brief false if only pawns on the board
     bool nonPawnMat(Color c) const;
 
@@ -832,6 +910,12 @@ class Board {
     /// @return
     bool isSquareAttacked(Color c, Square sq) const;
 
+    /// @brief enemy pieces giving check to the side to move
+    U64 checkers() const;
+
+    /// @brief is the side to move in check
+    bool inCheck() const;
+
     U64 allAttackers(Square sq, U64 occupiedBB);
     U64 attackersForSide(Color attackerColor, Square sq, U64 occupiedBB);
 
@@ -854,13 +938,13 @@ class Board {
     /// @param sq
     void removePiece(Piece piece, Square sq);
 
-    template <bool updateNNUE> void removePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue);
+    template <bool updateNNUE> void removePiece(Piece piece, Square sq, NNUE::Net& nnue);
 
     /// @brief Place a Piece on the board
     /// @param piece
     /// @param sq
     void placePiece(Piece piece, Square sq);
-    template <bool updateNNUE> void placePiece(Piece piece, Square sq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue);
+    template <bool updateNNUE> void placePiece(Piece piece, Square sq, NNUE::Net& nnue);
 
     /// @brief Move a piece on the board
     /// @param piece
@@ -869,7 +953,7 @@ class Board {
     void movePiece(Piece piece, Square fromSq, Square toSq);
 
     template <bool updateNNUE>
-    void movePiece(Piece piece, Square fromSq, Square toSq, Square kSQ_White, Square kSQ_Black, NNUE::Net& nnue);
+    void movePiece(Piece piece, Square fromSq, Square toSq, NNUE::Net& nnue);
 
     U64 attacksByPiece(PieceType pt, Square sq, Color c) const;
 
@@ -882,9 +966,6 @@ class Board {
     /// @return
     U64 zobristHash() const;
 
-    /// @brief initialize SQUARES_BETWEEN_BB array
-    void initializeLookupTables();
-
     // update the hash
 
     U64 updateKeyCastling() const;
@@ -982,8 +1063,7 @@ inline std::string Board::getFen() const {
 inline bool Board::isRepetition(int draw) const {
     uint8_t c = 0;
 
-    for (int i = static_cast<int>(hashHistory.size()) - 2;
-         i >= 0 && i >= static_cast<int>(hashHistory.size()) - halfMoveClock - 1; i -= 2) {
+    for (int i = hashHistory.size() - 2; i >= 0 && i >= hashHistory.size() - halfMoveClock - 1; i -= 2) {
         if (hashHistory[i] == hashKey)
             c++;
         if (c == draw)
@@ -1027,6 +1107,10 @@ inline bool Board::isSquareAttacked(Color c, Square sq) const {
     return false;
 }
 
+inline U64 Board::checkers() const { return checkersBB; }
+
+inline bool Board::inCheck() const { return checkersBB != 0; }
+
 inline U64 Board::allAttackers(Square sq, U64 occupiedBB) {
     return attackersForSide(White, sq, occupiedBB) | attackersForSide(Black, sq, occupiedBB);
 }
@@ -1122,22 +1206,6 @@ inline U64 Board::zobristHash() const {
     return hash ^ cast_hash ^ turn_hash ^ ep_hash;
 }
 
-inline void Board::initializeLookupTables() {
-    // initialize squares between table
-    U64 sqs;
-    for (Square sq1 = SQ_A1; sq1 <= SQ_H8; ++sq1) {
-        for (Square sq2 = SQ_A1; sq2 <= SQ_H8; ++sq2) {
-            sqs = (1ULL << sq1) | (1ULL << sq2);
-            if (sq1 == sq2)
-                SQUARES_BETWEEN_BB[sq1][sq2] = 0ull;
-            else if (square_file(sq1) == square_file(sq2) || square_rank(sq1) == square_rank(sq2))
-                SQUARES_BETWEEN_BB[sq1][sq2] = RookAttacks(sq1, sqs) & RookAttacks(sq2, sqs);
-            else if (diagonal_of(sq1) == diagonal_of(sq2) || anti_diagonal_of(sq1) == anti_diagonal_of(sq2))
-                SQUARES_BETWEEN_BB[sq1][sq2] = BishopAttacks(sq1, sqs) & BishopAttacks(sq2, sqs);
-        }
-    }
-}
-
 inline U64 Board::updateKeyPiece(Piece piece, Square sq) const { return RANDOM_ARRAY[64 * hash_piece[piece] + sq]; }
 
 inline U64 Board::updateKeyEnPassant(Square sq) const { return RANDOM_ARRAY[772 + square_file(sq)]; }
@@ -1242,57 +1310,26 @@ template <Color c> U64 pawnRightAttacks(const U64 pawns) {
  * When there is no check at all all bits are set (DEFAULT_CHECKMASK)
  *******************/
 template <Color c> U64 DoCheckmask(Board &board, Square sq) {
-    U64 Occ = board.occAll;
-    U64 checks = 0ULL;
-    U64 pawn_mask = board.pieces<PAWN, ~c>() & PawnAttacks(sq, c);
-    U64 knight_mask = board.pieces<KNIGHT, ~c>() & KnightAttacks(sq);
-    U64 bishop_mask = (board.pieces<BISHOP, ~c>() | board.pieces<QUEEN, ~c>()) & BishopAttacks(sq, Occ);
-    U64 rook_mask = (board.pieces<ROOK, ~c>() | board.pieces<QUEEN, ~c>()) & RookAttacks(sq, Occ);
+    const U64 checkers = board.checkers();
 
     /********************
      * We keep track of the amount of checks, in case there are
      * two checks on the board only the king can move!
+     * 3nk3/4P3/8/8/8/8/8/2K1R3 w - - 0 1, pawn promotes to queen or rook and
+     * suddenly the same piecetype gives check two times.
+     * King moves dont require the checkmask, so we can return early.
      *******************/
-    board.doubleCheck = 0;
+    board.doubleCheck = popcount(checkers);
 
-    if (pawn_mask) {
-        checks |= pawn_mask;
-        board.doubleCheck++;
-    }
-    if (knight_mask) {
-        checks |= knight_mask;
-        board.doubleCheck++;
-    }
-    if (bishop_mask) {
-        int8_t index = lsb(bishop_mask);
-
-        // Now we add the path!
-        checks |= board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
-        board.doubleCheck++;
-    }
-    if (rook_mask) {
-        /********************
-         * 3nk3/4P3/8/8/8/8/8/2K1R3 w - - 0 1, pawn promotes to queen or rook and
-         * suddenly the same piecetype gives check two times
-         * in that case we have a double check and can return early
-         * because king moves dont require the checkmask.
-         *******************/
-        if (popcount(rook_mask) > 1) {
-            board.doubleCheck = 2;
-            return checks;
-        }
-
-        int8_t index = lsb(rook_mask);
-
-        // Now we add the path!
-        checks |= board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
-        board.doubleCheck++;
-    }
-
-    if (!checks)
+    if (!checkers)
         return DEFAULT_CHECKMASK;
 
-    return checks;
+    if (board.doubleCheck > 1)
+        return checkers;
+
+    // Now we add the path! Knights and pawns are never aligned, so only the checker is added.
+    const Square index = lsb(checkers);
+    return SQUARES_BETWEEN_BB[sq][index] | (1ULL << index);
 }
 
 /********************
@@ -1311,7 +1348,7 @@ template <Color c> U64 DoPinMaskRooks(Board &board, Square sq) {
     U64 pinHV = 0ULL;
     while (rook_mask) {
         const Square index = poplsb(rook_mask);
-        const U64 possible_pin = (board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
+        const U64 possible_pin = (SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
         if (popcount(possible_pin & board.occUs) == 1)
             pinHV |= possible_pin;
     }
@@ -1325,7 +1362,7 @@ template <Color c> U64 DoPinMaskBishops(Board &board, Square sq) {
 
     while (bishop_mask) {
         const Square index = poplsb(bishop_mask);
-        const U64 possible_pin = (board.SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
+        const U64 possible_pin = (SQUARES_BETWEEN_BB[sq][index] | (1ULL << index));
         if (popcount(possible_pin & board.occUs) == 1)
             pinD |= possible_pin;
     }
@@ -1379,6 +1416,12 @@ template <Color c> U64 seenSquares(Board &board) {
  * setup important variables that we use for move generation.
  *******************/
 template <Color c> void init(Board &board, Square sq) {
+    // Already computed for this position, e.g. by isLegal for the TT move
+    if (board.masksReady)
+        return;
+
+    board.masksReady = true;
+
     board.occUs = board.Us<c>();
     board.occEnemy = board.Us<~c>();
     board.occAll = board.occUs | board.occEnemy;
@@ -1780,6 +1823,68 @@ template <Color c, Movetype mt> void legalmoves(Board &board, Movelist &movelist
     }
 }
 
+/********************
+ * Checks a move that was not generated in this position, e.g. from the TT or
+ * a killer slot, against the same masks legalmoves uses, but only for the
+ * piece that moves.
+ *******************/
+template <Color c> bool isLegal(Board &board, Move move) {
+    const Square from_sq = from(move);
+    const Square to_sq = to(move);
+    const PieceType pt = promoted(move) ? PAWN : piece(move);
+
+    if (from_sq == to_sq || board.pieceAtB(from_sq) != makePiece(pt, c))
+        return false;
+
+    init<c>(board, board.KingSQ(c));
+
+    if (board.doubleCheck == 2 && pt != KING)
+        return false;
+
+    const U64 movableSquare = board.checkMask & board.enemyEmptyBB;
+    const U64 fromBB = 1ULL << from_sq;
+
+    U64 moves = 0ULL;
+
+    switch (pt) {
+    case PAWN: {
+        Movelist list;
+        LegalPawnMovesAll<c, Movetype::ALL>(board, list);
+        return list.find(move) > -1;
+    }
+    case KNIGHT:
+        if (!(fromBB & (board.pinD | board.pinHV)))
+            moves = LegalKnightMoves(from_sq, movableSquare);
+        break;
+    case BISHOP:
+        if (!(fromBB & board.pinHV))
+            moves = LegalBishopMoves(board, from_sq, movableSquare);
+        break;
+    case ROOK:
+        if (!(fromBB & board.pinD))
+            moves = LegalRookMoves(board, from_sq, movableSquare);
+        break;
+    case QUEEN:
+        if (!(fromBB & board.pinD & board.pinHV))
+            moves = LegalQueenMoves(board, from_sq, movableSquare);
+        break;
+    case KING:
+        if (!board.castlingRights || board.checkMask != DEFAULT_CHECKMASK)
+            moves = LegalKingMoves<Movetype::ALL>(board, from_sq);
+        else
+            moves = LegalKingMovesCastling<c, Movetype::ALL>(board, from_sq);
+        break;
+    default:
+        return false;
+    }
+
+    return moves & (1ULL << to_sq);
+}
+
+inline bool isLegal(Board &board, Move move) {
+    return board.sideToMove == White ? isLegal<White>(board, move) : isLegal<Black>(board, move);
+}
+
 /********************
  * Entry function for the
  * Color template.
@@ -0,0 +1,233 @@
+#include "datagen.h"
+#include "misc.h"
+#include "numa.h"
+
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// a search score this far from 0 decides the game
+constexpr int ADJUDICATE_SCORE = 2500;
+
+// openings the random plies left further from balanced are thrown away,
+// their games would be decided before the engine plays a move
+constexpr int OPENING_SCORE_LIMIT = 600;
+constexpr int MAX_GAME_PLIES = 400;
+
+constexpr size_t FLUSH_RECORDS = 8192;
+
+PackedBoard pack(const Board &board, int score) {
+    PackedBoard packed{};
+
+    packed.occupancy = board.All();
+
+    U64 occupied = packed.occupancy;
+    for (int i = 0; occupied; i++) {
+        const Square sq = poplsb(occupied);
+        packed.pieces[i / 2] |= uint8_t(board.pieceAtB(sq)) << (4 * (i & 1));
+    }
+
+    packed.stm_ep = (board.sideToMove == Black ? 0x80 : 0) | (board.enPassantSquare == NO_SQ ? 64 : board.enPassantSquare);
+    packed.castling = board.castlingRights;
+    packed.halfmove = board.halfMoveClock;
+    packed.fullmove = board.fullMoveNumber;
+    packed.score = board.sideToMove == White ? score : -score;
+
+    return packed;
+}
+
+// Plays random legal moves from the start position, false if the game ended on the way
+bool random_opening(SearchThread &st, std::mt19937_64 &rng, int plies) {
+    st.applyFen(DEFAULT_POS);
+
+    for (int ply = 0; ply < plies; ply++) {
+        Movelist list;
+        Movegen::legalmoves<ALL>(st.board, list);
+
+        if (!list.size)
+            return false;
+
+        Move move = list[rng() % list.size].move;
+        st.makeMove<false>(move);
+        st.board.trimHistory();
+    }
+
+    Movelist list;
+    Movegen::legalmoves<ALL>(st.board, list);
+
+    return list.size;
+}
+
+} // namespace
+
+bool ParseDatagenOptions(int argc, char **argv, DatagenOptions &options) {
+    if (argc < 2)
+        return false;
+
+    options.output = argv[1];
+
+    for (int i = 2; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+
+        if (arg == "--threads")
+            options.threads = std::max(1, std::stoi(value));
+        else if (arg == "--nodes")
+            options.nodes = std::max<uint64_t>(1, std::stoull(value));
+        else if (arg == "--positions")
+            options.positions = std::stoull(value);
+        else if (arg == "--random-plies")
+            options.random_plies = std::max(0, std::stoi(value));
+        else if (arg == "--hash")
+            options.hash = std::max(1, std::stoi(value));
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void StartDatagen(const DatagenOptions &options) {
+    std::ofstream out(options.output, std::ios::binary | std::ios::app);
+    if (!out) {
+        std::cout << "Could not open " << options.output << std::endl;
+        return;
+    }
+
+    std::atomic<uint64_t> written = 0;
+    std::atomic<uint64_t> games = 0;
+    std::mutex out_mutex;
+
+    const auto start = misc::tick();
+    const uint64_t seed = std::random_device{}();
+
+    auto worker = [&](int id) {
+        // before anything is allocated, so the worker's state is local to its node
+        Numa::bind_thread(id, options.threads);
+
+        SearchInfo info;
+        info.depth = MAXPLY;
+        info.timeset = false;
+        info.nodeset = true;
+        info.nodes = options.nodes;
+
+        auto st = std::make_unique<SearchThread>(info);
+
+        // a private table, games never wait on each other or reinitialise it
+        auto own_table = std::make_unique<TranspositionTable>();
+        own_table->Initialize(options.hash);
+        st->tt = own_table.get();
+
+        std::mt19937_64 rng(seed + id);
+
+        std::vector<PackedBoard> buffer;
+        std::vector<PackedBoard> game;
+        buffer.reserve(FLUSH_RECORDS + MAX_GAME_PLIES);
+
+        auto flush = [&]() {
+            std::lock_guard lock(out_mutex);
+            out.write(reinterpret_cast<const char *>(buffer.data()), buffer.size() * sizeof(PackedBoard));
+            buffer.clear();
+        };
+
+        auto last_report = start;
+
+        while (written < options.positions) {
+            if (!random_opening(*st, rng, options.random_plies))
+                continue;
+
+            st->clear();
+            game.clear();
+
+            info.stopped = false;
+            iterative_deepening<false>(*st);
+
+            if (std::abs(st->completed_score) > OPENING_SCORE_LIMIT)
+                continue;
+
+            // 0 black wins, 1 draw, 2 white wins
+            uint8_t result = 1;
+
+            for (int ply = 0; ply < MAX_GAME_PLIES; ply++) {
+                Board &board = st->board;
+
+                Movelist list;
+                Movegen::legalmoves<ALL>(board, list);
+
+                if (!list.size) {
+                    if (board.inCheck())
+                        result = board.sideToMove == White ? 0 : 2;
+                    break;
+                }
+
+                if (board.isRepetition() || board.halfMoveClock >= 100 || popcount(board.All()) == 2)
+                    break;
+
+                info.stopped = false;
+                iterative_deepening<false>(*st);
+
+                Move move = st->completed_move != NO_MOVE ? st->completed_move : st->bestmove;
+                const int score = st->completed_score;
+
+                if (std::abs(score) >= ADJUDICATE_SCORE) {
+                    result = (score > 0) == (board.sideToMove == White) ? 2 : 0;
+                    break;
+                }
+
+                // only quiet positions are useful to train the eval on
+                if (!board.inCheck() && !promoted(move) && !is_capture(board, move))
+                    game.push_back(pack(board, score));
+
+                st->makeMove<false>(move);
+                board.trimHistory();
+            }
+
+            for (auto &packed : game) {
+                packed.result = result;
+                buffer.push_back(packed);
+            }
+
+            written += game.size();
+            games++;
+
+            if (buffer.size() >= FLUSH_RECORDS)
+                flush();
+
+            if (id == 0 && misc::tick() - last_report >= 10000) {
+                last_report = misc::tick();
+                const double seconds = (last_report - start) / 1000.0;
+                printf("%llu games, %llu positions, %.0f positions/s\n", static_cast<unsigned long long>(games.load()),
+                       static_cast<unsigned long long>(written.load()), written / seconds);
+                std::cout << std::flush;
+            }
+        }
+
+        flush();
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < options.threads; i++)
+        pool.emplace_back(worker, i);
+
+    worker(0);
+
+    for (auto &th : pool)
+        th.join();
+
+    const auto elapsed = misc::tick() - start;
+
+    printf("Wrote %llu positions from %llu games in %.2f s, %.0f positions/s\n",
+           static_cast<unsigned long long>(written.load()), static_cast<unsigned long long>(games.load()),
+           elapsed / 1000.0, 1000.0 * written / (elapsed + 1));
+    std::cout << std::flush;
+}
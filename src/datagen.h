@@ -0,0 +1,38 @@
+#pragma once
+
+#include "search.h"
+
+#include <string>
+
+struct DatagenOptions {
+    std::string output;
+
+    int threads = 1;
+    uint64_t nodes = 5000;       // soft node limit of every search
+    uint64_t positions = 100000; // stop once this many positions are written
+    int random_plies = 8;        // random opening moves before the engine takes over
+    int hash = 16;               // MB, every thread has its own table
+};
+
+// One training position, 32 bytes. The pieces are stored in the order of the
+// occupied squares (a1 first), two per byte with the first one in the low nibble.
+struct PackedBoard {
+    uint64_t occupancy;
+    uint8_t pieces[16];
+    uint8_t stm_ep;       // bit 7 set when black is to move, low bits en passant square or 64
+    uint8_t castling;     // wk = 1, wq = 2, bk = 4, bq = 8
+    uint8_t halfmove;
+    uint8_t result;       // 0 black wins, 1 draw, 2 white wins
+    uint16_t fullmove;
+    int16_t score;        // white relative cp
+};
+
+static_assert(sizeof(PackedBoard) == 32);
+
+/// @brief parses `datagen <out.bin> [--threads T] [--nodes N] [--positions N] [--random-plies P] [--hash H]`
+/// @return false on malformed arguments
+bool ParseDatagenOptions(int argc, char **argv, DatagenOptions &options);
+
+/// @brief plays self-play games on every thread and appends the quiet positions
+/// with their search score and game result to the output as PackedBoards
+void StartDatagen(const DatagenOptions &options);
@@ -0,0 +1,238 @@
+#include "evalbatch.h"
+#include "datagen.h"
+#include "misc.h"
+#include "numa.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace Chess;
+
+namespace {
+
+// Positions parsed and evaluated at a time by every thread
+constexpr size_t CHUNK = 4096;
+
+// FEN letters in Chess::Piece order
+constexpr char PIECE_CHARS[] = "PNBRQKpnbrqk";
+
+// Only the placement and side to move fields, anything after them is ignored
+bool parse_fen(const char *begin, const char *end, NNUE::BatchPosition &position) {
+    position.pieces.fill(0);
+
+    int rank = 7, file = 0;
+    const char *it = begin;
+
+    for (; it < end && *it != ' '; it++) {
+        const char c = *it;
+
+        if (c == '/') {
+            rank--;
+            file = 0;
+        } else if (c >= '1' && c <= '8') {
+            file += c - '0';
+        } else {
+            const char *piece = std::strchr(PIECE_CHARS, c);
+            if (!c || !piece || rank < 0 || file > 7)
+                return false;
+
+            position.pieces[piece - PIECE_CHARS] |= 1ULL << (rank * 8 + file);
+            file++;
+        }
+    }
+
+    position.side = it + 1 < end && it[1] == 'b' ? Black : White;
+
+    return popcount(position.pieces[WhiteKing]) == 1 && popcount(position.pieces[BlackKing]) == 1;
+}
+
+NNUE::BatchPosition unpack(const PackedBoard &packed) {
+    NNUE::BatchPosition position{};
+
+    U64 occupied = packed.occupancy;
+    for (int i = 0; occupied; i++) {
+        const Square sq = poplsb(occupied);
+        const int piece = (packed.pieces[i / 2] >> (4 * (i & 1))) & 0xF;
+
+        if (piece < None)
+            position.pieces[piece] |= 1ULL << sq;
+    }
+
+    position.side = packed.stm_ep & 0x80 ? Black : White;
+
+    return position;
+}
+
+// Moves a split point to the start of the next line
+size_t line_start(const std::string &data, size_t pos) {
+    if (pos == 0 || pos >= data.size())
+        return std::min(pos, data.size());
+
+    const size_t newline = data.find('\n', pos - 1);
+    return newline == std::string::npos ? data.size() : newline + 1;
+}
+
+void append_score(std::string &out, int32_t score) {
+    char buffer[16];
+    const auto result = std::to_chars(buffer, buffer + sizeof(buffer), score);
+
+    out.append(buffer, result.ptr);
+    out += '\n';
+}
+
+} // namespace
+
+bool ParseEvalBatchOptions(int argc, char **argv, EvalBatchOptions &options) {
+    if (argc < 3)
+        return false;
+
+    options.input = argv[1];
+    options.output = argv[2];
+    options.packed = options.input.size() > 4 && options.input.compare(options.input.size() - 4, 4, ".bin") == 0;
+
+    for (int i = 3; i < argc; i++) {
+        const std::string arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        const std::string value = argv[++i];
+
+        if (arg == "--threads")
+            options.threads = std::max(1, std::stoi(value));
+        else if (arg == "--format" && (value == "fen" || value == "packed"))
+            options.packed = value == "packed";
+        else
+            return false;
+    }
+
+    return true;
+}
+
+void StartEvalBatch(const EvalBatchOptions &options) {
+    std::ifstream in(options.input, std::ios::binary);
+    if (!in) {
+        std::cout << "Could not open " << options.input << std::endl;
+        return;
+    }
+
+    const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    const auto start = misc::tick();
+
+    const size_t records = data.size() / sizeof(PackedBoard);
+    const int threads = options.threads;
+
+    std::vector<std::string> results(threads);
+    std::vector<uint64_t> evaluated(threads);
+
+    auto worker = [&](int id) {
+        // before the net state is allocated, so it is local to the thread's node
+        Numa::bind_thread(id, threads);
+
+        auto net = std::make_unique<NNUE::Net>();
+
+        std::vector<NNUE::BatchPosition> positions;
+        std::vector<bool> valid;
+        std::vector<int32_t> scores(CHUNK);
+        positions.reserve(CHUNK);
+
+        std::string &out = results[id];
+
+        auto flush = [&]() {
+            net->EvaluateBatch(positions.data(), positions.size(), scores.data());
+
+            for (size_t i = 0, j = 0; i < valid.size(); i++) {
+                if (valid[i])
+                    append_score(out, scores[j++]);
+                else
+                    out += "invalid\n";
+            }
+
+            evaluated[id] += positions.size();
+            positions.clear();
+            valid.clear();
+        };
+
+        if (options.packed) {
+            const size_t begin = records * id / threads;
+            const size_t end = records * (id + 1) / threads;
+
+            for (size_t i = begin; i < end; i++) {
+                PackedBoard packed;
+                std::memcpy(&packed, data.data() + i * sizeof(PackedBoard), sizeof(packed));
+
+                positions.push_back(unpack(packed));
+                valid.push_back(true);
+
+                if (positions.size() == CHUNK)
+                    flush();
+            }
+        } else {
+            size_t pos = line_start(data, data.size() * id / threads);
+            const size_t end = line_start(data, data.size() * (id + 1) / threads);
+
+            while (pos < end) {
+                size_t eol = data.find('\n', pos);
+                if (eol == std::string::npos || eol > end)
+                    eol = end;
+
+                const char *line = data.data() + pos;
+                size_t length = eol - pos;
+                if (length && line[length - 1] == '\r')
+                    length--;
+
+                pos = eol + 1;
+
+                if (!length)
+                    continue;
+
+                NNUE::BatchPosition position;
+                const bool ok = parse_fen(line, line + length, position);
+
+                if (ok)
+                    positions.push_back(position);
+                valid.push_back(ok);
+
+                if (positions.size() == CHUNK)
+                    flush();
+            }
+        }
+
+        flush();
+    };
+
+    std::vector<std::thread> pool;
+    for (int i = 1; i < threads; i++)
+        pool.emplace_back(worker, i);
+
+    worker(0);
+
+    for (auto &th : pool)
+        th.join();
+
+    const auto elapsed = misc::tick() - start;
+
+    std::ofstream out(options.output, std::ios::binary);
+    for (const auto &result : results)
+        out.write(result.data(), result.size());
+
+    if (!out) {
+        std::cout << "Could not write " << options.output << std::endl;
+        return;
+    }
+
+    uint64_t total = 0;
+    for (uint64_t count : evaluated)
+        total += count;
+
+    printf("Evaluated %llu positions in %.2f s, %.0f positions/s\n", static_cast<unsigned long long>(total),
+           elapsed / 1000.0, 1000.0 * total / (elapsed + 1));
+    std::cout << std::flush;
+}
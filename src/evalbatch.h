@@ -0,0 +1,23 @@
+#pragma once
+
+#include "nnue.h"
+
+#include <string>
+
+struct EvalBatchOptions {
+    std::string input;
+    std::string output;
+
+    int threads = 1;
+    bool packed = false; // PackedBoard records from datagen instead of FEN lines, the default for .bin files
+};
+
+/// @brief parses `evalbatch <in> <out> [--threads T] [--format fen|packed]`
+/// @return false on malformed arguments
+bool ParseEvalBatchOptions(int argc, char **argv, EvalBatchOptions &options);
+
+/// @brief writes the static NNUE eval of every input position, side to move relative
+/// like the eval command, one per line in input order. FEN lines that have no king
+/// of either color are written as "invalid". Every thread takes a contiguous part of
+/// the input and parses and evaluates it in batches without building a Board.
+void StartEvalBatch(const EvalBatchOptions &options);
@@ -2,5 +2,5 @@
 #include "search.h"
 
 int evaluate(SearchThread& st) {
-    return st.nnue.Evaluate(st.board.sideToMove);
+    return st.nnue.Evaluate(st.board);
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ int NMPDivision = 3;
 int NMPMargin = 180;
 
 void init_all() {
+    Chess_Lookup::Sliders::init();
     init_search();
-    NNUE::Init("./test4.nn");
+    NNUE::Init();
 }
\ No newline at end of file
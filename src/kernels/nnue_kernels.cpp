@@ -0,0 +1,182 @@
+/*
+    Compiled once per instruction set by the makefile, with KERNEL_TARGET set
+    to the name of the set (generic, sse41, avx2, avx512, avx512vnni, neon).
+    The kernels are specialised for NetArch from nnue_arch.h.
+    Keep this free of anything with external linkage besides the table, the
+    same inline function built for different targets must never be merged.
+*/
+
+#include "../nnue_kernels.h"
+#include "../simd.h"
+
+#define KERNEL_STRINGIFY2(x) #x
+#define KERNEL_STRINGIFY(x) KERNEL_STRINGIFY2(x)
+
+namespace NNUE::Kernels::KERNEL_TARGET {
+
+namespace {
+
+constexpr int HIDDEN = NetArch::hidden_size;
+constexpr int16_t QA = NetArch::input_quantization;
+
+template <int Removes, int Adds>
+inline void update(const int16_t *input, int16_t *output, const int16_t *const *sub, const int16_t *const *add) {
+#if defined(USE_SIMD)
+    const auto in = reinterpret_cast<const register_type16 *>(input);
+    const auto out = reinterpret_cast<register_type16 *>(output);
+
+    for (int i = 0; i < HIDDEN / STRIDE_16_BIT; ++i) {
+        register_type16 reg = in[i];
+
+        for (int j = 0; j < Removes; ++j) {
+            reg = register_sub_epi16(reg, reinterpret_cast<const register_type16 *>(sub[j])[i]);
+        }
+
+        for (int j = 0; j < Adds; ++j) {
+            reg = register_add_epi16(reg, reinterpret_cast<const register_type16 *>(add[j])[i]);
+        }
+
+        out[i] = reg;
+    }
+#else
+    for (int i = 0; i < HIDDEN; ++i) {
+        int16_t value = input[i];
+
+        for (int j = 0; j < Removes; ++j) {
+            value -= sub[j][i];
+        }
+
+        for (int j = 0; j < Adds; ++j) {
+            value += add[j][i];
+        }
+
+        output[i] = value;
+    }
+#endif
+}
+
+void add(int16_t *accumulator, const int16_t *weights) {
+    const int16_t *rows[] = {weights};
+    update<0, 1>(accumulator, accumulator, nullptr, rows);
+}
+
+void sub(int16_t *accumulator, const int16_t *weights) {
+    const int16_t *rows[] = {weights};
+    update<1, 0>(accumulator, accumulator, rows, nullptr);
+}
+
+void sub_add(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *add0) {
+    const int16_t *subs[] = {sub0};
+    const int16_t *adds[] = {add0};
+    update<1, 1>(input, output, subs, adds);
+}
+
+void sub_sub_add(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *sub1,
+                 const int16_t *add0) {
+    const int16_t *subs[] = {sub0, sub1};
+    const int16_t *adds[] = {add0};
+    update<2, 1>(input, output, subs, adds);
+}
+
+void sub_sub_add_add(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *sub1,
+                     const int16_t *add0, const int16_t *add1) {
+    const int16_t *subs[] = {sub0, sub1};
+    const int16_t *adds[] = {add0, add1};
+    update<2, 2>(input, output, subs, adds);
+}
+
+#if defined(USE_SIMD)
+// One register of activated accumulator times weights, summed pairwise into acc.
+// SCReLU is computed as v * (v * w) so it costs a single madd like ReLU does,
+// which is exact as long as |v * w| fits in 16 bits (true for trained nets).
+inline register_type32 activate_dot(register_type32 acc, register_type16 input, register_type16 weights) {
+    const register_type16 zero{};
+
+    if constexpr (NetArch::activation == Activation::ReLU) {
+        return register_dpwssd_epi32(acc, register_max_epi16(input, zero), weights);
+    } else {
+        const register_type16 clipped = register_min_epi16(register_max_epi16(input, zero), register_set1_epi16(QA));
+
+        if constexpr (NetArch::activation == Activation::CReLU) {
+            return register_dpwssd_epi32(acc, clipped, weights);
+        } else {
+            return register_dpwssd_epi32(acc, clipped, register_mullo_epi16(clipped, weights));
+        }
+    }
+}
+#else
+inline int32_t activate(int16_t input) {
+    if constexpr (NetArch::activation == Activation::ReLU) {
+        return input > 0 ? input : 0;
+    } else {
+        const int32_t clipped = input < 0 ? 0 : (input > QA ? QA : input);
+        return NetArch::activation == Activation::CReLU ? clipped : clipped * clipped;
+    }
+}
+#endif
+
+int32_t forward(const int16_t *us, const int16_t *them, const int16_t *weights) {
+#if defined(USE_SIMD)
+    register_type32 res{};
+
+    const auto accumulator_us = reinterpret_cast<const register_type16 *>(us);
+    const auto accumulator_them = reinterpret_cast<const register_type16 *>(them);
+    const auto w = reinterpret_cast<const register_type16 *>(weights);
+
+    for (int i = 0; i < HIDDEN / STRIDE_16_BIT; i++) {
+        res = activate_dot(res, accumulator_us[i], w[i]);
+    }
+
+    for (int i = 0; i < HIDDEN / STRIDE_16_BIT; i++) {
+        res = activate_dot(res, accumulator_them[i], w[i + HIDDEN / STRIDE_16_BIT]);
+    }
+
+    return sumRegisterEpi32(res);
+#else
+    int32_t output = 0;
+
+    for (int i = 0; i < HIDDEN; i++) {
+        output += activate(us[i]) * weights[i];
+    }
+
+    for (int i = 0; i < HIDDEN; i++) {
+        output += activate(them[i]) * weights[HIDDEN + i];
+    }
+
+    return output;
+#endif
+}
+
+void forward_batch(const int16_t *const *us, const int16_t *const *them, const int16_t *weights, int32_t *output) {
+#if defined(USE_SIMD)
+    register_type32 res[FORWARD_BATCH]{};
+
+    const auto w = reinterpret_cast<const register_type16 *>(weights);
+
+    for (int i = 0; i < HIDDEN / STRIDE_16_BIT; i++) {
+        const register_type16 weights_us = w[i];
+        const register_type16 weights_them = w[i + HIDDEN / STRIDE_16_BIT];
+
+        for (int b = 0; b < FORWARD_BATCH; b++) {
+            res[b] = activate_dot(res[b], reinterpret_cast<const register_type16 *>(us[b])[i], weights_us);
+            res[b] = activate_dot(res[b], reinterpret_cast<const register_type16 *>(them[b])[i], weights_them);
+        }
+    }
+
+    for (int b = 0; b < FORWARD_BATCH; b++) {
+        output[b] = sumRegisterEpi32(res[b]);
+    }
+#else
+    for (int b = 0; b < FORWARD_BATCH; b++) {
+        output[b] = forward(us[b], them[b], weights);
+    }
+#endif
+}
+
+} // namespace
+
+extern const Table table = {
+    KERNEL_STRINGIFY(KERNEL_TARGET), add, sub, sub_add, sub_sub_add, sub_sub_add_add, forward, forward_batch,
+};
+
+} // namespace NNUE::Kernels::KERNEL_TARGET
@@ -0,0 +1,258 @@
+#include "microbench.h"
+#include "bench.h"
+#include "eval.h"
+#include "movescore.h"
+#include "see.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <x86intrin.h>
+#define HAS_RDTSC
+#endif
+
+namespace {
+
+// Keeps the compiler from dropping work whose result is never used
+template <typename T> inline void keep(const T &value) { asm volatile("" : : "r,m"(value) : "memory"); }
+
+// TSC ticks run at the nominal frequency, not the boosted core clock
+inline uint64_t cycles() {
+#ifdef HAS_RDTSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+inline uint64_t xorshift(uint64_t &state) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+}
+
+struct Result {
+    uint64_t ops = 0;
+    double ns = 0;
+    uint64_t cycles = 0;
+};
+
+// Times one batched loop, body returns how many ops it ran. A component sums
+// several of these (one per position), so setup between them isn't timed.
+template <typename Body> void measure(Result &result, Body &&body) {
+    const uint64_t start_cycles = cycles();
+    const auto start = std::chrono::steady_clock::now();
+
+    const uint64_t ops = body();
+
+    const auto end = std::chrono::steady_clock::now();
+    const uint64_t end_cycles = cycles();
+
+    result.ops += ops;
+    result.ns += std::chrono::duration<double, std::nano>(end - start).count();
+    result.cycles += end_cycles - start_cycles;
+}
+
+void report(const char *name, const Result &result) {
+    const double ops = static_cast<double>(std::max<uint64_t>(result.ops, 1));
+
+#ifdef HAS_RDTSC
+    printf("%-26s %12llu ops %10.2f ns/op %10.1f cycles/op\n", name, static_cast<unsigned long long>(result.ops),
+           result.ns / ops, result.cycles / ops);
+#else
+    printf("%-26s %12llu ops %10.2f ns/op %10s cycles/op\n", name, static_cast<unsigned long long>(result.ops),
+           result.ns / ops, "n/a");
+#endif
+}
+
+// Reversible (quiet, non pawn) move that keeps the repetition scan running
+Move reversible_move(Board &board) {
+    Movelist list;
+    Movegen::legalmoves<QUIET>(board, list);
+
+    for (auto &ext : list) {
+        if (board.pieceTypeAtB(from(ext.move)) != PAWN && board.pieceTypeAtB(from(ext.move)) != KING)
+            return ext.move;
+    }
+
+    return NO_MOVE;
+}
+
+void bench_positions() {
+    constexpr uint64_t REPS = 20000;
+
+    SearchInfo info;
+    auto st = std::make_unique<SearchThread>(info);
+    Board &board = st->board;
+
+    // Scoring reads the continuation histories of the two previous moves
+    SearchStack stack[8], *ss = stack + 4;
+    for (int i = -2; i < 0; i++) {
+        (ss + i)->move = Move(1);
+        (ss + i)->continuationHistory = &st->continuationHistory[WhiteKnight][i + 20];
+    }
+
+    Result movegen, make_unmake, make_unmake_nnue, eval, see_result, scoring, repetition;
+
+    for (auto &fen : bench_fens) {
+        st->applyFen(fen);
+
+        Movelist moves, captures, quiets;
+        Movegen::legalmoves<ALL>(board, moves);
+        Movegen::legalmoves<CAPTURE>(board, captures);
+        Movegen::legalmoves<QUIET>(board, quiets);
+
+        measure(movegen, [&]() {
+            for (uint64_t i = 0; i < REPS; i++) {
+                Movelist list;
+                Movegen::legalmoves<ALL>(board, list);
+                keep(list.size);
+            }
+            return REPS;
+        });
+
+        measure(make_unmake, [&]() {
+            for (uint64_t i = 0; i < REPS / 10; i++) {
+                for (auto &ext : moves) {
+                    st->makeMove<false>(ext.move);
+                    st->unmakeMove<false>(ext.move);
+                }
+            }
+            return REPS / 10 * moves.size;
+        });
+
+        measure(make_unmake_nnue, [&]() {
+            for (uint64_t i = 0; i < REPS / 10; i++) {
+                for (auto &ext : moves) {
+                    st->makeMove<true>(ext.move);
+                    st->unmakeMove<true>(ext.move);
+                }
+            }
+            return REPS / 10 * moves.size;
+        });
+
+        measure(eval, [&]() {
+            for (uint64_t i = 0; i < REPS; i++) {
+                keep(evaluate(*st));
+            }
+            return REPS;
+        });
+
+        measure(see_result, [&]() {
+            for (uint64_t i = 0; i < REPS / 10; i++) {
+                for (auto &ext : captures) {
+                    keep(see(board, ext.move, 0));
+                }
+            }
+            return REPS / 10 * captures.size;
+        });
+
+        measure(scoring, [&]() {
+            for (uint64_t i = 0; i < REPS / 10; i++) {
+                score_noisy(board, captures);
+                score_quiets(*st, quiets, ss);
+                keep(captures[0].value);
+                keep(quiets[0].value);
+            }
+            return REPS / 10 * (captures.size + quiets.size);
+        });
+
+        // Shuffle pieces for a while, so the scan has a real history to walk through
+        Move played[16];
+        int count = 0;
+        for (; count < 16; count++) {
+            played[count] = reversible_move(board);
+            if (played[count] == NO_MOVE)
+                break;
+            st->makeMove<false>(played[count]);
+        }
+
+        measure(repetition, [&]() {
+            for (uint64_t i = 0; i < REPS; i++) {
+                keep(board.isRepetition());
+            }
+            return REPS;
+        });
+
+        while (count--) {
+            st->unmakeMove<false>(played[count]);
+        }
+    }
+
+    report("legalmoves<ALL>", movegen);
+    report("make/unmake", make_unmake);
+    report("make/unmake with NNUE", make_unmake_nnue);
+    report("evaluate", eval);
+    report("see", see_result);
+    report("score moves (per move)", scoring);
+    report("isRepetition", repetition);
+}
+
+void bench_tt(int mb) {
+    constexpr uint64_t OPS = 1 << 22;
+    constexpr uint64_t SEED = 0x9E3779B97F4A7C15ull;
+
+    TranspositionTable tt;
+    tt.Initialize(mb);
+
+    Result store, probe, chain;
+    uint64_t state = SEED;
+
+    measure(store, [&]() {
+        for (uint64_t i = 0; i < OPS; i++) {
+            tt.store(xorshift(state), HFBETA, NO_MOVE, i & 31, 0, 0, 0, false);
+        }
+        return OPS;
+    });
+
+    // Same keys again, in a small table most of them have been replaced by now
+    state = SEED;
+    uint64_t hits = 0;
+
+    measure(probe, [&]() {
+        for (uint64_t i = 0; i < OPS; i++) {
+            bool hit = false;
+            TTEntry &entry = tt.probe_entry(xorshift(state), hit, 0);
+            hits += hit;
+            keep(entry.depth);
+        }
+        return OPS;
+    });
+
+    // Every key depends on the entry found before, so the loads can't overlap
+    // and the result is the latency of one probe instead of the throughput
+    measure(chain, [&]() {
+        uint64_t key = SEED;
+        for (uint64_t i = 0; i < OPS; i++) {
+            bool hit = false;
+            TTEntry &entry = tt.probe_entry(xorshift(key), hit, 0);
+            key += entry.depth + hit;
+        }
+        keep(key);
+        return OPS;
+    });
+
+    const std::string size = " (" + std::to_string(mb) + " MB)";
+
+    report(("TT store" + size).c_str(), store);
+    report(("TT probe" + size).c_str(), probe);
+    report(("TT probe chain" + size).c_str(), chain);
+    printf("%-26s %11.1f%%\n", ("TT hit rate" + size).c_str(), 100.0 * hits / OPS);
+}
+
+} // namespace
+
+void StartMicroBench(int large_hash_mb) {
+    bench_positions();
+
+    bench_tt(16);
+    bench_tt(large_hash_mb);
+
+    std::cout << std::flush;
+}
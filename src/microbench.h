@@ -0,0 +1,8 @@
+#pragma once
+
+/// @brief times the search hot paths one component at a time: movegen, make/unmake,
+/// evaluate, SEE, move scoring, isRepetition and TT probe/store. Every component runs
+/// as one batched loop that is timed as a whole, so the clock costs nothing per op.
+/// @param large_hash_mb size of the second TT, the first one is 16 MB and fits
+/// the caches a lot better
+void StartMicroBench(int large_hash_mb);
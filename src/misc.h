@@ -3,6 +3,10 @@
 #include <cstdint>
 #include <chrono>
 
+#if defined(__linux__)
+#include <time.h>
+#endif
+
 namespace misc {
 
 template<typename Duration = std::chrono::milliseconds>
@@ -12,4 +16,18 @@ inline double tick()
     return (double)std::chrono::duration_cast<Duration>(std::chrono::steady_clock::now().time_since_epoch()).count();
 }
 
+// Milliseconds on the same monotonic time base as tick(), for the clock polled
+// inside the search. On Linux it reads the coarse clock, which costs a few ns
+// and may lag a scheduler tick behind.
+inline int64_t coarse_tick()
+{
+#if defined(__linux__) && defined(CLOCK_MONOTONIC_COARSE)
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+#else
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
 }
\ No newline at end of file
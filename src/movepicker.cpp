@@ -0,0 +1,163 @@
+#include "movepicker.h"
+#include "movescore.h"
+
+MovePicker::MovePicker(SearchThread &st, SearchStack *ss, Move tt_move, bool noisy_only)
+    : st(st), ss(ss), tt_move(tt_move), noisy_only(noisy_only) {}
+
+bool MovePicker::is_noisy(Move move) {
+    return promoted(move) || st.board.colorOf(to(move)) == ~st.board.sideToMove;
+}
+
+bool MovePicker::is_quiet(Move move) {
+    const bool en_passant = piece(move) == PAWN && to(move) == st.board.enPassantSquare;
+    return !promoted(move) && !en_passant && st.board.pieceAtB(to(move)) == None;
+}
+
+bool MovePicker::is_refutation(Move move) { return move == killer1 || move == killer2 || move == counter; }
+
+Move MovePicker::next_move(bool skip_quiets) {
+    Board &board = st.board;
+
+    while (true) {
+        switch (stage) {
+        case PICK_TT_MOVE:
+            stage = GEN_NOISY;
+
+            if (tt_move != NO_MOVE && (!noisy_only || is_noisy(tt_move)) && Movegen::isLegal(board, tt_move)) {
+                return tt_move;
+            }
+
+            tt_move = NO_MOVE;
+            break;
+
+        case GEN_NOISY:
+            Movegen::legalmoves<CAPTURE>(board, noisy);
+            score_noisy(board, noisy);
+
+            stage = PICK_GOOD_NOISY;
+            break;
+
+        case PICK_GOOD_NOISY:
+            while (index < noisy.size) {
+                pick_nextmove(index, noisy);
+
+                // Sorted from here on, everything left loses material
+                if (noisy[index].value < GoodCaptureScore) {
+                    break;
+                }
+
+                const Move move = noisy[index++].move;
+
+                if (move != tt_move) {
+                    return move;
+                }
+            }
+
+            bad_index = index;
+            stage = noisy_only ? PICK_BAD_NOISY : PICK_KILLER_1;
+            break;
+
+        case PICK_KILLER_1:
+            stage = PICK_KILLER_2;
+
+            if (skip_quiets) {
+                stage = PICK_BAD_NOISY;
+                break;
+            }
+
+            if (ss->killers[0] != tt_move && is_quiet(ss->killers[0]) && Movegen::isLegal(board, ss->killers[0])) {
+                killer1 = ss->killers[0];
+                return killer1;
+            }
+            break;
+
+        case PICK_KILLER_2:
+            stage = PICK_COUNTER;
+
+            if (skip_quiets) {
+                stage = PICK_BAD_NOISY;
+                break;
+            }
+
+            if (ss->killers[1] != tt_move && ss->killers[1] != killer1 && is_quiet(ss->killers[1]) &&
+                Movegen::isLegal(board, ss->killers[1])) {
+                killer2 = ss->killers[1];
+                return killer2;
+            }
+            break;
+
+        case PICK_COUNTER: {
+            stage = GEN_QUIET;
+
+            if (skip_quiets) {
+                stage = PICK_BAD_NOISY;
+                break;
+            }
+
+            const Move previous = (ss - 1)->move;
+
+            if (previous == NO_MOVE || previous == NULL_MOVE) {
+                break;
+            }
+
+            const Move move = st.counterMoves[(ss - 1)->moved_piece][to(previous)];
+
+            if (move != tt_move && move != killer1 && move != killer2 && is_quiet(move) &&
+                Movegen::isLegal(board, move)) {
+                counter = move;
+                return counter;
+            }
+            break;
+        }
+
+        case GEN_QUIET:
+            if (skip_quiets) {
+                stage = PICK_BAD_NOISY;
+                break;
+            }
+
+            Movegen::legalmoves<QUIET>(board, quiets);
+            score_quiets(st, quiets, ss);
+
+            index = 0;
+            stage = PICK_QUIET;
+            break;
+
+        case PICK_QUIET:
+            while (!skip_quiets && index < quiets.size) {
+                pick_nextmove(index, quiets);
+
+                const Move move = quiets[index++].move;
+
+                if (move != tt_move && !is_refutation(move)) {
+                    return move;
+                }
+            }
+
+            stage = PICK_BAD_NOISY;
+            break;
+
+        case PICK_BAD_NOISY:
+            // bad_index is where the good captures stopped, the quiet stages
+            // reuse index
+            index = bad_index;
+
+            while (index < noisy.size) {
+                pick_nextmove(index, noisy);
+
+                const Move move = noisy[index++].move;
+                bad_index = index;
+
+                if (move != tt_move) {
+                    return move;
+                }
+            }
+
+            stage = PICK_DONE;
+            break;
+
+        case PICK_DONE:
+            return NO_MOVE;
+        }
+    }
+}
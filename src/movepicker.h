@@ -0,0 +1,51 @@
+#pragma once
+
+#include "search.h"
+
+enum PickerStage : uint8_t {
+    PICK_TT_MOVE,
+    GEN_NOISY,
+    PICK_GOOD_NOISY,
+    PICK_KILLER_1,
+    PICK_KILLER_2,
+    PICK_COUNTER,
+    GEN_QUIET,
+    PICK_QUIET,
+    PICK_BAD_NOISY,
+    PICK_DONE
+};
+
+/* Hands out the moves of a node one at a time. The TT move is tried before
+ * anything is generated, then captures and promotions that pass SEE, the
+ * killers and the counter move, history ordered quiets and finally the losing
+ * captures. A stage is only generated once the ones before it failed to cut
+ * off. With noisy_only (qsearch, probcut) the quiet stages are left out. */
+struct MovePicker {
+    MovePicker(SearchThread &st, SearchStack *ss, Move tt_move, bool noisy_only);
+
+    // Returns NO_MOVE once every move has been handed out
+    Move next_move(bool skip_quiets);
+
+    PickerStage stage = PICK_TT_MOVE;
+
+  private:
+    SearchThread &st;
+    SearchStack *ss;
+
+    Move tt_move;
+    Move killer1 = NO_MOVE;
+    Move killer2 = NO_MOVE;
+    Move counter = NO_MOVE;
+
+    bool noisy_only;
+
+    Movelist noisy;
+    Movelist quiets;
+
+    int index = 0;
+    int bad_index = 0;
+
+    bool is_noisy(Move move);
+    bool is_quiet(Move move);
+    bool is_refutation(Move move);
+};
@@ -20,52 +20,38 @@ static inline int get_conthist_score(SearchThread& st, SearchStack *ss,
     return score;
 }
 
-// Move scoring
-void score_moves(SearchThread& st, Movelist &list, SearchStack *ss, Move tt_move) {
+// Scores captures and promotions, the ones that do not lose material get
+// GoodCaptureScore on top so they are tried before killers and quiets
+void score_noisy(Board &board, Movelist &list) {
 
-    // Loop through moves in movelist.
     for (int i = 0; i < list.size; i++) {
-        Piece victim = st.board.pieceAtB(to(list[i].move));
-        Piece attacker = st.board.pieceAtB(from(list[i].move));
+        Piece victim = board.pieceAtB(to(list[i].move));
+        Piece attacker = board.pieceAtB(from(list[i].move));
 
-        // Score tt move the highest
-        if (list[i].move == tt_move) {
-            list[i].value = PvMoveScore;
-        } else if (victim != None) {
+        if (victim != None) {
             // If it's a capture move, we score using MVVLVA (Most valuable
             // victim, Least Valuable Attacker) and if see move that doesn't
             // lose material, we add additional bonus
-
             list[i].value = mvv_lva[attacker][victim] +
-                            (GoodCaptureScore * see(st.board, list[i].move, -107));
-        } else if (list[i].move == ss->killers[0]) {
-            // Score for killer 1
-            list[i].value = Killer1Score;
-        } else if (list[i].move == ss->killers[1]) {
-            // Score for killer 2
-            list[i].value = Killer2Score;
+                            (GoodCaptureScore * see(board, list[i].move, -107));
+        } else if (piece(list[i].move) == QUEEN) {
+            // Quiet queen promotions are ordered as if they won a queen
+            list[i].value = mvv_lva[attacker][WhiteQueen] +
+                            (GoodCaptureScore * see(board, list[i].move, -107));
         } else {
-            // Otherwise, history score.
-            list[i].value = st.searchHistory[attacker][to(list[i].move)] + get_conthist_score(st, ss, list[i].move);
+            // Underpromotions are left for the losing captures stage
+            list[i].value = 0;
         }
     }
 }
 
-// Used for Qsearch move scoring
-void score_moves(Board &board, Movelist &list, Move tt_move) {
+// Scores quiet moves by their history and continuation history
+void score_quiets(SearchThread& st, Movelist &list, SearchStack *ss) {
 
-    // Loop through moves in movelist.
     for (int i = 0; i < list.size; i++) {
-        Piece victim = board.pieceAtB(to(list[i].move));
-        Piece attacker = board.pieceAtB(from(list[i].move));
-        if (list[i].move == tt_move) {
-            list[i].value = 20000000;
-        } else if (victim != None) {
-            // If it's a capture move, we score using MVVLVA (Most valuable
-            // victim, Least Valuable Attacker)
-            list[i].value = mvv_lva[attacker][victim] +
-                            (GoodCaptureScore * see(board, list[i].move, -107));
-        }
+        Piece attacker = st.board.pieceAtB(from(list[i].move));
+
+        list[i].value = st.searchHistory[attacker][to(list[i].move)] + get_conthist_score(st, ss, list[i].move);
     }
 }
 
@@ -111,7 +97,7 @@ void updateContinuationHistories(SearchStack* ss, Piece piece, Move move, int bo
     }
 }
 
-void updateHistories(SearchThread& st, SearchStack *ss, Move bestmove, Movelist &quietList, int depth){
+void updateHistories(SearchThread& st, SearchStack *ss, Move bestmove, SearchedMoves &quietList, int depth){
     // Update best move score
     int bonus = historyBonus(depth);
 
@@ -121,7 +107,7 @@ void updateHistories(SearchThread& st, SearchStack *ss, Move bestmove, Movelist
     }
 
     for (int i = 0; i < quietList.size; i++) {
-        Move move = quietList[i].move;
+        Move move = quietList[i];
 
         if (move == bestmove)
             continue; // Don't give penalty to our best move, so skip it.
@@ -132,6 +118,26 @@ void updateHistories(SearchThread& st, SearchStack *ss, Move bestmove, Movelist
     }
 }
 
+static inline int16_t& pawnCorrection(SearchThread& st) {
+    return st.pawnCorrectionHistory[st.board.sideToMove][st.board.pawnKey & (CORRECTION_HISTORY_SIZE - 1)];
+}
+
+int correctedEval(SearchThread& st, int raw_eval) {
+    const int eval = raw_eval + pawnCorrection(st) / CORRECTION_GRAIN;
+
+    return std::clamp(eval, IS_MATED_IN_MAX_PLY + 1, IS_MATE_IN_MAX_PLY - 1);
+}
+
+void updateCorrectionHistory(SearchThread& st, int depth, int diff) {
+    int16_t& entry = pawnCorrection(st);
+
+    // Moving average of the error, deeper results get a larger weight
+    const int weight = std::min(depth + 1, 16);
+    const int updated = (entry * (CORRECTION_WEIGHT_SCALE - weight) + diff * CORRECTION_GRAIN * weight) / CORRECTION_WEIGHT_SCALE;
+
+    entry = std::clamp(updated, -MAXCORRECTION, MAXCORRECTION);
+}
+
 int get_history_scores(int &his, int &ch, int &fmh, SearchThread& st, SearchStack *ss, const Move move) {
     Move previous_move = (ss - 1)->move;
     Move previous_previous_move = (ss - 2)->move;
@@ -4,202 +4,291 @@
 #include <algorithm>
 #include <chrono>
 #include <cstring>
+#include <new>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef NNFILE
+#define NNFILE "./hexadecane_512_v2.net"
+#endif
 
 #define INCBIN_STYLE INCBIN_STYLE_CAMEL
 #include "incbin/incbin.h"
-INCBIN(EVAL, "./hexadecane_512_v2.net");
+INCBIN(EVAL, NNFILE);
 
 using namespace Chess;
 
-#if defined(__AVX__) || defined(__AVX2__)
-alignas(ALIGNMENT) std::array<int16_t, INPUT_SIZE * HIDDEN_SIZE> inputWeights;
-alignas(ALIGNMENT) std::array<int16_t, HIDDEN_SIZE> inputBias;
-alignas(ALIGNMENT) std::array<int16_t, HIDDEN_SIZE * 2> hiddenWeights;
-alignas(ALIGNMENT) std::array<int32_t, OUTPUT_SIZE> hiddenBias;
-#else
-std::array<int16_t, INPUT_SIZE * HIDDEN_SIZE> inputWeights;
-std::array<int16_t, HIDDEN_SIZE> inputBias;
-std::array<int16_t, HIDDEN_SIZE * 2> hiddenWeights;
-std::array<int32_t, OUTPUT_SIZE> hiddenBias;
-#endif
+const int16_t *inputWeights;
+const int16_t *inputBias;
+const int16_t *hiddenWeights;
+const int32_t *hiddenBias;
 
 namespace NNUE {
 
-Net::Net() { std::fill(accumulator_stack.begin(), accumulator_stack.end(), Accumulator()); }
+namespace Kernels {
 
-template void Net::updateAccumulator<true>(Chess::PieceType, Chess::Color, Chess::Square, Chess::Square, Chess::Square);
-template void Net::updateAccumulator<false>(Chess::PieceType, Chess::Color, Chess::Square, Chess::Square,
-                                            Chess::Square);
+#if defined(KERNELS_X86)
+namespace sse41 { extern const Table table; }
+namespace avx2 { extern const Table table; }
+namespace avx512 { extern const Table table; }
+namespace avx512vnni { extern const Table table; }
+#elif defined(KERNELS_ARM)
+namespace neon { extern const Table table; }
+#endif
+namespace generic { extern const Table table; }
+
+const Table *active = &generic::table;
+
+void select() {
+#if defined(KERNELS_X86)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vnni")) {
+        active = &avx512vnni::table;
+    } else if (__builtin_cpu_supports("avx512bw")) {
+        active = &avx512::table;
+    } else if (__builtin_cpu_supports("avx2")) {
+        active = &avx2::table;
+    } else if (__builtin_cpu_supports("sse4.1")) {
+        active = &sse41::table;
+    }
+#elif defined(KERNELS_ARM)
+    // Advanced SIMD is mandatory on AArch64
+    active = &neon::table;
+#endif
+}
 
-template <bool add>
-void Net::updateAccumulator(Chess::PieceType pieceType, Chess::Color pieceColor, Chess::Square square,
-                            Chess::Square kingSquare_White, Chess::Square kingSquare_Black) {
+} // namespace Kernels
 
-    Accumulator &accumulator = accumulator_stack[currentAccumulator];
+Net::Net() {
+    std::fill(accumulator_stack.begin(), accumulator_stack.end(), Accumulator());
+    reset_refresh_cache();
+}
 
-#if defined(USE_SIMD)
-    for (auto side : {White, Black}) {
-        const int inputs =
-            index(pieceType, pieceColor, square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-        const auto weights = reinterpret_cast<register_type16 *>(inputWeights.data() + inputs * HIDDEN_SIZE);
-        const auto input = reinterpret_cast<register_type16 *>(accumulator[side].data());
-        const auto output = reinterpret_cast<register_type16 *>(accumulator[side].data());
-
-        if constexpr (add) {
-            for (int i = 0; i < HIDDEN_SIZE / STRIDE_16_BIT / 4; ++i) {
-                output[i * 4 + 0] = register_add_epi16(input[i * 4 + 0], weights[i * 4 + 0]);
-                output[i * 4 + 1] = register_add_epi16(input[i * 4 + 1], weights[i * 4 + 1]);
-                output[i * 4 + 2] = register_add_epi16(input[i * 4 + 2], weights[i * 4 + 2]);
-                output[i * 4 + 3] = register_add_epi16(input[i * 4 + 3], weights[i * 4 + 3]);
-            }
-        } else {
-            for (int i = 0; i < HIDDEN_SIZE / STRIDE_16_BIT / 4; ++i) {
-                output[i * 4 + 0] = register_sub_epi16(input[i * 4 + 0], weights[i * 4 + 0]);
-                output[i * 4 + 1] = register_sub_epi16(input[i * 4 + 1], weights[i * 4 + 1]);
-                output[i * 4 + 2] = register_sub_epi16(input[i * 4 + 2], weights[i * 4 + 2]);
-                output[i * 4 + 3] = register_sub_epi16(input[i * 4 + 3], weights[i * 4 + 3]);
+void Net::reset_refresh_cache() {
+    for (auto &side : refresh_cache) {
+        for (auto &bucket : side) {
+            for (auto &entry : bucket) {
+                std::copy(inputBias, inputBias + HIDDEN_SIZE, std::begin(entry.accumulator));
+                entry.pieces.fill(0ULL);
             }
         }
     }
-#else
-    for (auto side : {White, Black}) {
-        const int inputs =
-            index(pieceType, pieceColor, square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-        const auto weights = inputWeights.data() + inputs * HIDDEN_SIZE;
-
-        if constexpr (add) {
-            for (int i = 0; i < HIDDEN_SIZE / 4; ++i) {
-                accumulator[side][i * 4 + 0] += weights[i * 4 + 0];
-                accumulator[side][i * 4 + 1] += weights[i * 4 + 1];
-                accumulator[side][i * 4 + 2] += weights[i * 4 + 2];
-                accumulator[side][i * 4 + 3] += weights[i * 4 + 3];
-            }
-        } else {
-            for (int i = 0; i < HIDDEN_SIZE / 4; ++i) {
-                accumulator[side][i * 4 + 0] -= weights[i * 4 + 0];
-                accumulator[side][i * 4 + 1] -= weights[i * 4 + 1];
-                accumulator[side][i * 4 + 2] -= weights[i * 4 + 2];
-                accumulator[side][i * 4 + 3] -= weights[i * 4 + 3];
-            }
-        }
+}
+
+// Adds or subtracts a single feature from one perspective of an accumulator
+template <bool add> static inline void updateFeature(int16_t *accumulator, const int feature) {
+    const int16_t *weights = inputWeights + feature * HIDDEN_SIZE;
+
+    if constexpr (add) {
+        Kernels::active->add(accumulator, weights);
+    } else {
+        Kernels::active->sub(accumulator, weights);
     }
-#endif
 }
 
-void Net::updateAccumulator(Chess::PieceType pieceType, Chess::Color pieceColor, Chess::Square from_square,
-                            Chess::Square to_square, Chess::Square kingSquare_White, Chess::Square kingSquare_Black) {
+/* Brings one perspective of the current accumulator up to date. We walk back
+ * to the closest ancestor that is already computed and replay the recorded
+ * deltas from there. If the king of this perspective changed bucket on the
+ * way, replaying is impossible and we refresh from the cache instead. */
+void Net::computeAccumulator(Board &board, Color side) {
+    if (accumulator_stack[currentAccumulator].computed[side]) {
+        return;
+    }
+
+    int32_t i = currentAccumulator;
 
-    Accumulator &accumulator = accumulator_stack[currentAccumulator];
-#if defined(USE_SIMD)
-    for (auto side : {White, Black}) {
-        const int inputClear =
-            index(pieceType, pieceColor, from_square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-        const int inputAdd =
-            index(pieceType, pieceColor, to_square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-
-        const auto weightSub = reinterpret_cast<register_type16 *>(inputWeights.data() + inputClear * HIDDEN_SIZE);
-        const auto weightAdd = reinterpret_cast<register_type16 *>(inputWeights.data() + inputAdd * HIDDEN_SIZE);
-        const auto input = reinterpret_cast<register_type16 *>(accumulator[side].data());
-        const auto output = reinterpret_cast<register_type16 *>(accumulator[side].data());
-
-        for (int i = 0; i < HIDDEN_SIZE / STRIDE_16_BIT / 4; ++i) {
-            output[i * 4 + 0] =
-                register_add_epi16(register_sub_epi16(input[i * 4 + 0], weightSub[i * 4 + 0]), weightAdd[i * 4 + 0]);
-            output[i * 4 + 1] =
-                register_add_epi16(register_sub_epi16(input[i * 4 + 1], weightSub[i * 4 + 1]), weightAdd[i * 4 + 1]);
-            output[i * 4 + 2] =
-                register_add_epi16(register_sub_epi16(input[i * 4 + 2], weightSub[i * 4 + 2]), weightAdd[i * 4 + 2]);
-            output[i * 4 + 3] =
-                register_add_epi16(register_sub_epi16(input[i * 4 + 3], weightSub[i * 4 + 3]), weightAdd[i * 4 + 3]);
+    while (!accumulator_stack[i].computed[side]) {
+        if (accumulator_stack[i].needs_refresh[side] || i == 0) {
+            refresh(board, side);
+            return;
         }
+        i--;
     }
-#else
-    for (auto side : {White, Black}) {
-        const int inputClear =
-            index(pieceType, pieceColor, from_square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-        const int inputAdd =
-            index(pieceType, pieceColor, to_square, side, side == Chess::White ? kingSquare_White : kingSquare_Black);
-
-        const auto weightSub = inputWeights.data() + inputClear * HIDDEN_SIZE;
-        const auto weightAdd = inputWeights.data() + inputAdd * HIDDEN_SIZE;
-
-        for (int i = 0; i < HIDDEN_SIZE / 4; ++i) {
-            accumulator[side][i * 4 + 0] += -weightSub[i * 4 + 0] + weightAdd[i * 4 + 0];
-            accumulator[side][i * 4 + 1] += -weightSub[i * 4 + 1] + weightAdd[i * 4 + 1];
-            accumulator[side][i * 4 + 2] += -weightSub[i * 4 + 2] + weightAdd[i * 4 + 2];
-            accumulator[side][i * 4 + 3] += -weightSub[i * 4 + 3] + weightAdd[i * 4 + 3];
+
+    const Chess::Square kingSquare = board.KingSQ(side);
+
+    for (i++; i <= currentAccumulator; i++) {
+        Accumulator &accumulator = accumulator_stack[i];
+        const Accumulator::Delta &delta = accumulator.delta;
+
+        int removed[2], added[2];
+
+        for (int j = 0; j < delta.removed; j++) {
+            const Piece piece = delta.remove_piece[j];
+            removed[j] = index(type_of_piece(piece), piece < BlackPawn ? White : Black, delta.remove_square[j], side,
+                               kingSquare);
         }
+
+        for (int j = 0; j < delta.added; j++) {
+            const Piece piece = delta.add_piece[j];
+            added[j] = index(type_of_piece(piece), piece < BlackPawn ? White : Black, delta.add_square[j], side,
+                             kingSquare);
+        }
+
+        const int16_t *input = accumulator_stack[i - 1][side].data();
+        int16_t *output = accumulator[side].data();
+
+        // Weight rows of the features, the fused kernels apply them in a single pass
+        const auto row = [](int feature) { return inputWeights + feature * HIDDEN_SIZE; };
+
+        if (delta.removed == 1 && delta.added == 1) {
+            Kernels::active->sub_add(input, output, row(removed[0]), row(added[0]));
+        } else if (delta.removed == 2 && delta.added == 1) {
+            Kernels::active->sub_sub_add(input, output, row(removed[0]), row(removed[1]), row(added[0]));
+        } else if (delta.removed == 2 && delta.added == 2) {
+            Kernels::active->sub_sub_add_add(input, output, row(removed[0]), row(removed[1]), row(added[0]),
+                                             row(added[1]));
+        } else {
+            std::copy(input, input + HIDDEN_SIZE, output);
+
+            for (int j = 0; j < delta.removed; j++) {
+                updateFeature<false>(output, removed[j]);
+            }
+
+            for (int j = 0; j < delta.added; j++) {
+                updateFeature<true>(output, added[j]);
+            }
+        }
+
+        accumulator.computed[side] = true;
     }
-#endif
 }
 
 void Net::refresh(Board &board) {
+    refresh(board, White);
+    refresh(board, Black);
+}
 
-    Accumulator &accumulator = accumulator_stack[currentAccumulator];
-    accumulator.clear();
+/* Instead of rebuilding the perspective from the bias, start from the cached
+ * accumulator of the same king bucket and only apply the pieces that were
+ * added or removed since that entry was last used. */
+void Net::refresh(Board &board, Color side) { refresh(board.piecesBB, accumulator_stack[currentAccumulator], side); }
 
-    U64 pieces = board.All();
+void Net::refresh(const uint64_t *pieces, Accumulator &accumulator, Color side) {
+    const Chess::Square kingSquare = lsb(pieces[side == White ? WhiteKing : BlackKing]);
+    RefreshEntry &entry = refresh_cache[side][kingSquareIndex(kingSquare, side)][!!(kingSquare & 0x4)];
 
-    const Chess::Square kingSquare_White = board.KingSQ(Chess::White);
-    const Chess::Square kingSquare_Black = board.KingSQ(Chess::Black);
+    for (Piece p = WhitePawn; p < None; p++) {
+        const PieceType pt = type_of_piece(p);
+        const Color color = p < BlackPawn ? White : Black;
 
-    while (pieces) {
-        Chess::Square sq = Chess::poplsb(pieces);
-        Chess::PieceType pt = board.pieceTypeAtB(sq);
+        U64 added = pieces[p] & ~entry.pieces[p];
+        U64 removed = entry.pieces[p] & ~pieces[p];
+
+        while (added) {
+            updateFeature<true>(entry.accumulator.data(), index(pt, color, poplsb(added), side, kingSquare));
+        }
 
-        updateAccumulator<true>(pt, board.colorOf(sq), sq, kingSquare_White, kingSquare_Black);
+        while (removed) {
+            updateFeature<false>(entry.accumulator.data(), index(pt, color, poplsb(removed), side, kingSquare));
+        }
+
+        entry.pieces[p] = pieces[p];
     }
+
+    std::copy(std::begin(entry.accumulator), std::end(entry.accumulator), std::begin(accumulator[side]));
+    accumulator.computed[side] = true;
+}
+
+static inline int outputBucket(int pieces) { return OUTPUT_SIZE > 1 ? NetArch::output_bucket(pieces) : 0; }
+
+// Turns the raw output layer sum into centipawns
+static inline int32_t scaleOutput(int32_t output, int bucket) {
+    // SCReLU squares the activation and so carries one extra input quantization
+    if constexpr (NetArch::activation == Activation::SCReLU) {
+        output /= INPUT_QUANTIZATION;
+    }
+
+    output += hiddenBias[bucket];
+
+    return output / (INPUT_QUANTIZATION * HIDDEN_QUANTIZATON);
 }
 
-int32_t Net::Evaluate(Color side) {
+int32_t Net::Evaluate(Board &board) {
+    computeAccumulator(board, White);
+    computeAccumulator(board, Black);
+
+    const Color side = board.sideToMove;
     Accumulator &accumulator = accumulator_stack[currentAccumulator];
 
-#if defined(USE_SIMD)
+    const int bucket = outputBucket(popcount(board.All()));
 
-    register_type16 reluBias{};
-    register_type32 res{};
+    int32_t output = Kernels::active->forward(accumulator[side].data(), accumulator[!side].data(),
+                                              hiddenWeights + bucket * HIDDEN_DSIZE);
 
-    const auto accumulator_us = reinterpret_cast<register_type16 *>(accumulator[side].data());
-    const auto accumulator_them = reinterpret_cast<register_type16 *>(accumulator[!side].data());
-    const auto weights = reinterpret_cast<register_type16 *>(hiddenWeights.data());
+    return scaleOutput(output, bucket);
+}
 
-    for (int i = 0; i < HIDDEN_SIZE / STRIDE_16_BIT; i++) {
-        res = register_add_epi32(res, register_madd_epi16(register_max_epi16(accumulator_us[i], reluBias), weights[i]));
-    }
+static_assert(FORWARD_BATCH <= ACCUMULATOR_STACK_SIZE);
+
+/* The start of the accumulator stack holds the batch. Every group of
+ * FORWARD_BATCH positions goes through the output layer in one kernel call,
+ * a short last group repeats its last position. Groups that mix output
+ * buckets are evaluated one position at a time. */
+void Net::EvaluateBatch(const BatchPosition *positions, size_t count, int32_t *scores) {
+    const int16_t *us[FORWARD_BATCH];
+    const int16_t *them[FORWARD_BATCH];
+    int buckets[FORWARD_BATCH];
+    int32_t outputs[FORWARD_BATCH];
+
+    for (size_t first = 0; first < count; first += FORWARD_BATCH) {
+        const int size = static_cast<int>(std::min<size_t>(FORWARD_BATCH, count - first));
+        bool same_bucket = true;
+
+        for (int b = 0; b < FORWARD_BATCH; b++) {
+            const int source = std::min(b, size - 1);
+            const BatchPosition &position = positions[first + source];
+            Accumulator &accumulator = accumulator_stack[source];
+
+            if (b < size) {
+                refresh(position.pieces.data(), accumulator, White);
+                refresh(position.pieces.data(), accumulator, Black);
+            }
 
-    for (int i = 0; i < HIDDEN_SIZE / STRIDE_16_BIT; i++) {
-        res = register_add_epi32(res, register_madd_epi16(register_max_epi16(accumulator_them[i], reluBias), weights[i + HIDDEN_SIZE / STRIDE_16_BIT]));
-    }
+            us[b] = accumulator[position.side].data();
+            them[b] = accumulator[!position.side].data();
 
-    const auto output = sumRegisterEpi32(res) + hiddenBias[0];
-    return output / (INPUT_QUANTIZATION * HIDDEN_QUANTIZATON);
+            uint64_t occupied = 0;
+            for (uint64_t bb : position.pieces) {
+                occupied |= bb;
+            }
 
-#else
-    int32_t output = hiddenBias[0];
+            buckets[b] = outputBucket(popcount(occupied));
+            same_bucket &= buckets[b] == buckets[0];
+        }
 
-    for (int chunks = 0; chunks < HIDDEN_SIZE / 256; chunks++) {
-        const int offset = chunks * 256;
-        for (int i = 0; i < 256; i++) {
-            output += relu(accumulator[side][i + offset]) * hiddenWeights[i + offset];
+        if (same_bucket) {
+            Kernels::active->forward_batch(us, them, hiddenWeights + buckets[0] * HIDDEN_DSIZE, outputs);
+        } else {
+            for (int b = 0; b < size; b++) {
+                outputs[b] = Kernels::active->forward(us[b], them[b], hiddenWeights + buckets[b] * HIDDEN_DSIZE);
+            }
         }
-    }
 
-    for (int chunks = 0; chunks < HIDDEN_SIZE / 256; chunks++) {
-        const int offset = chunks * 256;
-        for (int i = 0; i < 256; i++) {
-            output += relu(accumulator[!side][i + offset]) * hiddenWeights[HIDDEN_SIZE + i + offset];
+        for (int b = 0; b < size; b++) {
+            scores[first + b] = scaleOutput(outputs[b], buckets[b]);
         }
     }
 
-    return output / INPUT_QUANTIZATION / HIDDEN_QUANTIZATON;
-
-#endif
+    // The stack no longer matches any board
+    reset_accumulators();
+    accumulator_stack[0].computed[White] = accumulator_stack[0].computed[Black] = false;
 }
 
 void Net::Benchmark() {
 
     Board board(DEFAULT_POS, *this);
 
+    std::cout << "Using " << Kernels::active->name << " kernels\n" << std::endl;
     std::cout << "Testing Evaluation speed...\n" << std::endl;
 
     float eval_time_sum = 0;
@@ -214,7 +303,7 @@ void Net::Benchmark() {
 
         for (int i = 0; i < 1e7; i++) {
             auto start = std::chrono::steady_clock::now();
-            eval = Evaluate(board.sideToMove);
+            eval = Evaluate(board);
             auto end = std::chrono::steady_clock::now();
 
             time_sum += std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
@@ -262,6 +351,8 @@ void Net::Benchmark() {
                 auto start = std::chrono::steady_clock::now();
 
                 board.makeMove<true>(list[i].move, *this);
+                computeAccumulator(board, White);
+                computeAccumulator(board, Black);
                 board.unmakeMove<true>(list[i].move, *this);
 
                 auto end = std::chrono::steady_clock::now();
@@ -282,30 +373,265 @@ void Net::Benchmark() {
     std::cout << "Average update time: " << update_time_sum / bench_fens.size() << " ns" << std::endl;
 }
 
-void ReadBin() {
-    uint64_t memoryIndex = 0;
+constexpr uint64_t INPUT_WEIGHTS_SIZE = uint64_t(INPUT_SIZE) * HIDDEN_SIZE * sizeof(int16_t);
+constexpr uint64_t INPUT_BIAS_SIZE = HIDDEN_SIZE * sizeof(int16_t);
+constexpr uint64_t HIDDEN_WEIGHTS_SIZE = HIDDEN_DSIZE * OUTPUT_SIZE * sizeof(int16_t);
+constexpr uint64_t HIDDEN_BIAS_SIZE = OUTPUT_SIZE * sizeof(int32_t);
+constexpr uint64_t PAYLOAD_SIZE = INPUT_WEIGHTS_SIZE + INPUT_BIAS_SIZE + HIDDEN_WEIGHTS_SIZE + HIDDEN_BIAS_SIZE;
+
+constexpr char NET_MAGIC[8] = {'R', 'I', 'C', 'E', 'N', 'N', 'U', 'E'};
+
+// The currently mapped net file, if any
+struct MappedFile {
+    const void *data = nullptr;
+    uint64_t size = 0;
+#if defined(_WIN32)
+    HANDLE mapping = nullptr;
+#endif
+};
+
+static MappedFile mapped;
+
+// Copy of the embedded net, only made if the linker did not align it for the kernels
+static int16_t *embeddedCopy = nullptr;
+
+// FNV-1a over 64 bit words, cheap enough to run on every load
+static uint64_t checksum(const uint8_t *data, uint64_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    uint64_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ULL;
+    }
+
+    for (; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static NetHeader makeHeader(const uint8_t *payload) {
+    NetHeader header{};
+
+    std::memcpy(header.magic, NET_MAGIC, sizeof(header.magic));
+    header.version = NET_VERSION;
+    header.input_size = INPUT_SIZE;
+    header.hidden_size = HIDDEN_SIZE;
+    header.output_buckets = OUTPUT_SIZE;
+    header.activation = static_cast<uint32_t>(NetArch::activation);
+    header.input_quantization = INPUT_QUANTIZATION;
+    header.hidden_quantization = HIDDEN_QUANTIZATON;
+    header.payload_size = PAYLOAD_SIZE;
+    header.checksum = checksum(payload, PAYLOAD_SIZE);
+
+    return header;
+}
 
-    std::memcpy(inputWeights.data(), &gEVALData[memoryIndex], INPUT_SIZE * HIDDEN_SIZE * sizeof(int16_t));
-    memoryIndex += INPUT_SIZE * HIDDEN_SIZE * sizeof(int16_t);
+// Returns the payload of a net file if the header matches the architecture we were built for
+static const uint8_t *validate(const uint8_t *data, uint64_t size, std::string &error) {
+    if (size < sizeof(NetHeader)) {
+        error = "file too small";
+        return nullptr;
+    }
 
-    std::memcpy(inputBias.data(), &gEVALData[memoryIndex], HIDDEN_SIZE * sizeof(int16_t));
-    memoryIndex += HIDDEN_SIZE * sizeof(int16_t);
+    NetHeader header;
+    std::memcpy(&header, data, sizeof(header));
+
+    const uint8_t *payload = data + sizeof(NetHeader);
+
+    if (std::memcmp(header.magic, NET_MAGIC, sizeof(NET_MAGIC)) != 0) {
+        error = "not a net file";
+    } else if (header.version != NET_VERSION) {
+        error = "unsupported version " + std::to_string(header.version);
+    } else if (header.input_size != INPUT_SIZE || header.hidden_size != HIDDEN_SIZE ||
+               header.output_buckets != OUTPUT_SIZE ||
+               header.activation != static_cast<uint32_t>(NetArch::activation) ||
+               header.input_quantization != INPUT_QUANTIZATION || header.hidden_quantization != HIDDEN_QUANTIZATON) {
+        error = "architecture does not match this build";
+    } else if (header.payload_size != PAYLOAD_SIZE || size - sizeof(NetHeader) < PAYLOAD_SIZE) {
+        error = "truncated payload";
+    } else if (header.checksum != checksum(payload, PAYLOAD_SIZE)) {
+        error = "checksum mismatch";
+    } else {
+        return payload;
+    }
 
-    std::memcpy(hiddenWeights.data(), &gEVALData[memoryIndex], HIDDEN_DSIZE * OUTPUT_SIZE * sizeof(int16_t));
-    memoryIndex += HIDDEN_DSIZE * OUTPUT_SIZE * sizeof(int16_t);
+    return nullptr;
+}
 
-    std::memcpy(hiddenBias.data(), &gEVALData[memoryIndex], OUTPUT_SIZE * sizeof(int32_t));
-    memoryIndex += OUTPUT_SIZE * sizeof(int32_t);
+static void usePayload(const uint8_t *payload) {
+    inputWeights = reinterpret_cast<const int16_t *>(payload);
+    inputBias = reinterpret_cast<const int16_t *>(payload + INPUT_WEIGHTS_SIZE);
+    hiddenWeights = reinterpret_cast<const int16_t *>(payload + INPUT_WEIGHTS_SIZE + INPUT_BIAS_SIZE);
+    hiddenBias =
+        reinterpret_cast<const int32_t *>(payload + INPUT_WEIGHTS_SIZE + INPUT_BIAS_SIZE + HIDDEN_WEIGHTS_SIZE);
 
 #ifdef DEBUG
-    std::cout << "Memory index: " << memoryIndex << std::endl;
-    std::cout << "Size: " << gEVALSize << std::endl;
     std::cout << "Bias: " << hiddenBias[0] / INPUT_QUANTIZATION / HIDDEN_QUANTIZATON << std::endl;
+#endif
+}
 
-    std::cout << std::endl;
+static void unmap(MappedFile &file) {
+    if (file.data == nullptr) {
+        return;
+    }
+
+#if defined(_WIN32)
+    UnmapViewOfFile(file.data);
+    CloseHandle(file.mapping);
+#else
+    munmap(const_cast<void *>(file.data), file.size);
 #endif
+
+    file = MappedFile();
 }
 
-void Init(const std::string &file_name) { ReadBin(); }
+static bool map(const std::string &file_name, MappedFile &file) {
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(handle, &size);
+
+    file.mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(handle);
+
+    if (file.mapping == nullptr) {
+        return false;
+    }
+
+    file.data = MapViewOfFile(file.mapping, FILE_MAP_READ, 0, 0, 0);
+    file.size = size.QuadPart;
+
+    if (file.data == nullptr) {
+        CloseHandle(file.mapping);
+        return false;
+    }
+#else
+    const int fd = open(file_name.c_str(), O_RDONLY);
+
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat st;
+
+    if (fstat(fd, &st) == -1 || st.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    file.data = data;
+    file.size = st.st_size;
+#endif
+
+    return true;
+}
+
+bool LoadFile(const std::string &file_name) {
+    MappedFile file;
+
+    if (!map(file_name, file)) {
+        std::cout << "info string Could not open EvalFile " << file_name << std::endl;
+        return false;
+    }
+
+    std::string error;
+    const uint8_t *payload = validate(static_cast<const uint8_t *>(file.data), file.size, error);
+
+    if (payload == nullptr) {
+        std::cout << "info string Invalid EvalFile " << file_name << ": " << error << std::endl;
+        unmap(file);
+        return false;
+    }
+
+    usePayload(payload);
+
+    unmap(mapped);
+    mapped = file;
+
+    std::cout << "info string Loaded EvalFile " << file_name << std::endl;
+
+    return true;
+}
+
+/* The embedded net is either a headered net file or, like hexadecane, raw
+ * trainer output in the payload layout. It is used in place unless the linker
+ * placed it below the alignment the kernels need. */
+void LoadEmbedded() {
+    const uint8_t *data = gEVALData;
+    std::string error;
+
+    const uint8_t *payload = validate(data, gEVALSize, error);
+
+    if (payload == nullptr) {
+        payload = data;
+
+        if (gEVALSize < PAYLOAD_SIZE) {
+            std::cout << "info string Embedded net does not match this build" << std::endl;
+            exit(1);
+        }
+    }
+
+    if (reinterpret_cast<uintptr_t>(payload) % ALIGNMENT != 0) {
+        if (embeddedCopy == nullptr) {
+            embeddedCopy = new (std::align_val_t(ALIGNMENT)) int16_t[PAYLOAD_SIZE / sizeof(int16_t) + 1];
+            std::memcpy(embeddedCopy, payload, PAYLOAD_SIZE);
+        }
+
+        payload = reinterpret_cast<const uint8_t *>(embeddedCopy);
+    }
+
+    usePayload(payload);
+    unmap(mapped);
+}
+
+// Wraps raw trainer output into a net file for this build's architecture
+bool PackFile(const std::string &raw_file, const std::string &net_file) {
+    std::ifstream in(raw_file, std::ios::binary);
+    std::vector<uint8_t> payload(PAYLOAD_SIZE);
+
+    if (!in || !in.read(reinterpret_cast<char *>(payload.data()), PAYLOAD_SIZE)) {
+        std::cout << "Could not read " << PAYLOAD_SIZE << " bytes from " << raw_file << std::endl;
+        return false;
+    }
+
+    const NetHeader header = makeHeader(payload.data());
+
+    std::ofstream out(net_file, std::ios::binary);
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(payload.data()), PAYLOAD_SIZE);
+
+    if (!out) {
+        std::cout << "Could not write " << net_file << std::endl;
+        return false;
+    }
+
+    std::cout << "Wrote " << net_file << " (checksum " << std::hex << header.checksum << std::dec << ")" << std::endl;
+    return true;
+}
+
+void Init(const std::string &file_name) {
+    Kernels::select();
+
+    if (file_name.empty() || !LoadFile(file_name)) {
+        LoadEmbedded();
+    }
+}
 
-} // namespace NNUE
\ No newline at end of file
+} // namespace NNUE
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "chess.hpp"
-#include "simd.h"
+#include "nnue_kernels.h"
 
 #include <array>
 #include <cstdint>
@@ -18,17 +18,23 @@
 
 #define BUCKETS (16)
 #define INPUT_SIZE (64 * 12 * BUCKETS)
-#define HIDDEN_SIZE (512)
+#define HIDDEN_SIZE (NNUE::NetArch::hidden_size)
 #define HIDDEN_DSIZE (HIDDEN_SIZE * 2)
-#define OUTPUT_SIZE (1)
+#define OUTPUT_SIZE (NNUE::NetArch::output_buckets)
 
-#define INPUT_QUANTIZATION (32)
-#define HIDDEN_QUANTIZATON (128)
+// One accumulator per move on the search path: MAXPLY plies plus the probcut
+// moves, which are made without advancing the ply. Checked in search.h.
+#define ACCUMULATOR_STACK_SIZE (128)
 
-extern std::array<int16_t, INPUT_SIZE * HIDDEN_SIZE> inputWeights;
-extern std::array<int16_t, HIDDEN_SIZE> inputBias;
-extern std::array<int16_t, HIDDEN_SIZE * 2> hiddenWeights;
-extern std::array<int32_t, OUTPUT_SIZE> hiddenBias;
+#define INPUT_QUANTIZATION (NNUE::NetArch::input_quantization)
+#define HIDDEN_QUANTIZATON (NNUE::NetArch::hidden_quantization)
+
+// Weights of the loaded net. They point straight into the embedded net or the
+// mapped net file, so they are never copied.
+extern const int16_t *inputWeights;
+extern const int16_t *inputBias;
+extern const int16_t *hiddenWeights;
+extern const int32_t *hiddenBias;
 
 namespace NNUE {
 
@@ -63,16 +69,26 @@ inline int index(Chess::PieceType pieceType, Chess::Color pieceColor, Chess::Squ
     // clang-format on
 }
 
-static inline int16_t relu(int16_t input) { return std::max(static_cast<int16_t>(0), input); }
-
 struct Accumulator {
-#if defined(USE_SIMD)
     alignas(ALIGNMENT) std::array<int16_t, HIDDEN_SIZE> white;
     alignas(ALIGNMENT) std::array<int16_t, HIDDEN_SIZE> black;
-#else
-    std::array<int16_t, HIDDEN_SIZE> white;
-    std::array<int16_t, HIDDEN_SIZE> black;
-#endif
+
+    // Features added and removed by the move that led to this accumulator.
+    // A move changes at most two of each (castling, captures, promotions).
+    struct Delta {
+        uint8_t added = 0;
+        uint8_t removed = 0;
+
+        Chess::Piece add_piece[2];
+        Chess::Square add_square[2];
+        Chess::Piece remove_piece[2];
+        Chess::Square remove_square[2];
+    } delta;
+
+    // Whether each perspective has been brought up to date yet, and whether
+    // it has to be refreshed because its king crossed a bucket or the mirror.
+    bool computed[2] = {false, false};
+    bool needs_refresh[2] = {false, false};
 
     std::array<int16_t, HIDDEN_SIZE> &operator[](Chess::Color side) { return side == Chess::White ? white : black; }
     std::array<int16_t, HIDDEN_SIZE> &operator[](bool side) { return side ? black : white; }
@@ -83,21 +99,43 @@ struct Accumulator {
     }
 
     inline void clear() {
-        std::copy(std::begin(inputBias), std::end(inputBias), std::begin(white));
-        std::copy(std::begin(inputBias), std::end(inputBias), std::begin(black));
+        std::copy(inputBias, inputBias + HIDDEN_SIZE, std::begin(white));
+        std::copy(inputBias, inputBias + HIDDEN_SIZE, std::begin(black));
     }
 };
 
+// A position reduced to what the net reads, so it can be evaluated without a Board
+struct BatchPosition {
+    std::array<uint64_t, 12> pieces; // bitboards in Chess::Piece order
+    Chess::Color side;
+};
+
+// One cached accumulator perspective together with the pieces it was built from
+struct RefreshEntry {
+    alignas(ALIGNMENT) std::array<int16_t, HIDDEN_SIZE> accumulator;
+    std::array<uint64_t, 12> pieces;
+};
+
 struct Net {
     int32_t currentAccumulator = 0;
 
-    std::array<Accumulator, 512> accumulator_stack;
+    std::array<Accumulator, ACCUMULATOR_STACK_SIZE> accumulator_stack;
+
+    // Refresh cache ("Finny tables") indexed by [perspective][king bucket][mirrored]
+    std::array<std::array<std::array<RefreshEntry, 2>, BUCKETS>, 2> refresh_cache;
 
     Net();
 
+    void reset_refresh_cache();
+
+    // Only records that a move was made, the accumulator itself is computed
+    // lazily once an evaluation actually needs it.
     inline void push() {
-        accumulator_stack[currentAccumulator + 1].copy(accumulator_stack[currentAccumulator]);
-        currentAccumulator++;
+        Accumulator &accumulator = accumulator_stack[++currentAccumulator];
+
+        accumulator.delta.added = accumulator.delta.removed = 0;
+        accumulator.computed[Chess::White] = accumulator.computed[Chess::Black] = false;
+        accumulator.needs_refresh[Chess::White] = accumulator.needs_refresh[Chess::Black] = false;
     }
     inline void pull() { 
         currentAccumulator--; 
@@ -107,14 +145,35 @@ struct Net {
     }
 
     void refresh(Chess::Board &board);
+    void refresh(Chess::Board &board, Chess::Color side);
+    void refresh(const uint64_t *pieces, Accumulator &accumulator, Chess::Color side);
 
-    template <bool add>
-    void updateAccumulator(Chess::PieceType pieceType, Chess::Color pieceColor, Chess::Square square,  Chess::Square kingSquare_White, Chess::Square kingSquare_Black);
+    inline void addFeature(Chess::Piece piece, Chess::Square square) {
+        Accumulator::Delta &delta = accumulator_stack[currentAccumulator].delta;
 
-    void updateAccumulator(Chess::PieceType pieceType, Chess::Color pieceColor, Chess::Square from_square,
-                           Chess::Square to_square, Chess::Square kingSquare_White, Chess::Square kingSquare_Black);
+        delta.add_piece[delta.added] = piece;
+        delta.add_square[delta.added] = square;
+        delta.added++;
+    }
+
+    inline void removeFeature(Chess::Piece piece, Chess::Square square) {
+        Accumulator::Delta &delta = accumulator_stack[currentAccumulator].delta;
+
+        delta.remove_piece[delta.removed] = piece;
+        delta.remove_square[delta.removed] = square;
+        delta.removed++;
+    }
+
+    inline void requestRefresh(Chess::Color side) { accumulator_stack[currentAccumulator].needs_refresh[side] = true; }
+
+    void computeAccumulator(Chess::Board &board, Chess::Color side);
 
-    int32_t Evaluate(Chess::Color side);
+    int32_t Evaluate(Chess::Board &board);
+
+    // Side to move scores of count positions, the same as Evaluate gives. The
+    // accumulators are built from the refresh cache, so positions that share
+    // most of their pieces (consecutive positions of a game) refresh cheaply.
+    void EvaluateBatch(const BatchPosition *positions, size_t count, int32_t *scores);
 
     void Benchmark();
 
@@ -141,6 +200,39 @@ struct Net {
     }
 };
 
-void Init(const std::string &file_name);
+/* Net files start with this header, followed by the payload: input weights,
+ * input bias, hidden weights and hidden bias, in that order. The header is 64
+ * bytes so the payload stays aligned for the kernels when the file is mapped.
+ * Raw trainer output can be wrapped with "Rice nn-pack <raw> <out>". */
+#define NET_VERSION (1)
+
+struct NetHeader {
+    char magic[8];
+    uint32_t version;
+
+    // Architecture the weights were trained for
+    uint32_t input_size;
+    uint32_t hidden_size;
+    uint32_t output_buckets;
+    uint32_t activation;
+    uint32_t input_quantization;
+    uint32_t hidden_quantization;
+    uint32_t reserved;
+
+    uint64_t payload_size;
+    uint64_t checksum;
+    uint8_t padding[8];
+};
+
+static_assert(sizeof(NetHeader) == 64);
+
+// Loads file_name, falling back to the embedded net if it is empty or invalid
+void Init(const std::string &file_name = "");
+
+// Maps a net file and switches to it, the current net stays on failure
+bool LoadFile(const std::string &file_name);
+void LoadEmbedded();
+
+bool PackFile(const std::string &raw_file, const std::string &net_file);
 
 } // namespace NNUE
\ No newline at end of file
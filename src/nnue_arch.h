@@ -0,0 +1,32 @@
+#pragma once
+
+namespace NNUE {
+
+enum class Activation { ReLU, CReLU, SCReLU };
+
+/* Everything that fixes the shape of a network, (INPUT_SIZE -> HiddenSize)x2 -> OutputBuckets.
+ * The kernels are specialised on it, so switching nets with a different shape
+ * only means changing NetArch below and rebuilding. */
+template <int HiddenSize, Activation Act, int OutputBuckets, int InputQuantization, int HiddenQuantization>
+struct Architecture {
+    static constexpr int hidden_size = HiddenSize;
+    static constexpr Activation activation = Act;
+    static constexpr int output_buckets = OutputBuckets;
+    static constexpr int input_quantization = InputQuantization;
+    static constexpr int hidden_quantization = HiddenQuantization;
+
+    // Every kernel walks the hidden layer in whole 512 bit registers
+    static_assert(HiddenSize % 32 == 0);
+    static_assert(OutputBuckets >= 1 && OutputBuckets <= 32);
+
+    // Output buckets split the games by the number of pieces left on the board
+    static constexpr int output_bucket(int pieces) {
+        constexpr int divisor = (32 + OutputBuckets - 1) / OutputBuckets;
+        return (pieces - 2) / divisor;
+    }
+};
+
+// hexadecane_512_v2
+using NetArch = Architecture<512, Activation::ReLU, 1, 32, 128>;
+
+} // namespace NNUE
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "nnue_arch.h"
+
+#include <cstdint>
+
+// Every kernel uses aligned loads of up to 512 bits
+#define ALIGNMENT (64)
+
+// Positions forward_batch evaluates together
+#define FORWARD_BATCH (8)
+
+namespace NNUE::Kernels {
+
+/* The accumulator and output layer kernels of one instruction set, specialised
+ * for NetArch. Each set is built from kernels/nnue_kernels.cpp with its own
+ * target flags and the one matching the running CPU is picked by select() at
+ * startup. All rows are NetArch::hidden_size long. */
+struct Table {
+    const char *name;
+
+    // accumulator += weights / accumulator -= weights, in place
+    void (*add)(int16_t *accumulator, const int16_t *weights);
+    void (*sub)(int16_t *accumulator, const int16_t *weights);
+
+    // Fused updates that read the parent once and write the child once
+    void (*sub_add)(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *add0);
+    void (*sub_sub_add)(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *sub1,
+                        const int16_t *add0);
+    void (*sub_sub_add_add)(const int16_t *input, int16_t *output, const int16_t *sub0, const int16_t *sub1,
+                            const int16_t *add0, const int16_t *add1);
+
+    // activation(us) . weights[0, hidden) + activation(them) . weights[hidden, 2 * hidden),
+    // for SCReLU still scaled by an extra input_quantization
+    int32_t (*forward)(const int16_t *us, const int16_t *them, const int16_t *weights);
+
+    // forward for FORWARD_BATCH positions sharing the output weights, each weight
+    // register is loaded once for the whole batch
+    void (*forward_batch)(const int16_t *const *us, const int16_t *const *them, const int16_t *weights,
+                          int32_t *output);
+};
+
+extern const Table *active;
+
+void select();
+
+} // namespace NNUE::Kernels
@@ -0,0 +1,106 @@
+#include "numa.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace Numa {
+
+namespace {
+
+// Parses sysfs lists like "0-15,32-47"
+std::vector<int> parse_list(const std::string &list) {
+    std::vector<int> values;
+    std::istringstream is(list);
+
+    for (std::string range; std::getline(is, range, ',');) {
+        if (range.empty())
+            continue;
+
+        const size_t dash = range.find('-');
+        const int first = std::stoi(range.substr(0, dash));
+        const int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+
+        for (int i = first; i <= last; i++)
+            values.push_back(i);
+    }
+
+    return values;
+}
+
+std::vector<std::vector<int>> detect() {
+    std::vector<std::vector<int>> topology;
+
+#if defined(__linux__)
+    std::string online;
+    std::ifstream("/sys/devices/system/node/online") >> online;
+
+    // CPUs the process may run on, a container or taskset can hide some of them
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    sched_getaffinity(0, sizeof(allowed), &allowed);
+
+    for (int node : parse_list(online)) {
+        std::string cpulist;
+        std::ifstream("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist") >> cpulist;
+
+        std::vector<int> cpus;
+        for (int cpu : parse_list(cpulist)) {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))
+                cpus.push_back(cpu);
+        }
+
+        if (!cpus.empty())
+            topology.push_back(std::move(cpus));
+    }
+#endif
+
+    return topology;
+}
+
+} // namespace
+
+const std::vector<std::vector<int>> &nodes() {
+    static const std::vector<std::vector<int>> topology = detect();
+    return topology;
+}
+
+bool set_policy(const std::string &name) {
+    if (name == "auto")
+        policy = Policy::Auto;
+    else if (name == "pin")
+        policy = Policy::Pin;
+    else if (name == "none")
+        policy = Policy::None;
+    else
+        return false;
+
+    return true;
+}
+
+void bind_thread(int index, int threads) {
+    const auto &topology = nodes();
+
+    if (policy == Policy::None || topology.empty() || (policy == Policy::Auto && topology.size() < 2) ||
+        threads < 2)
+        return;
+
+#if defined(__linux__)
+    // Consecutive threads go to different nodes, so any thread count is spread evenly
+    const auto &cpus = topology[index % topology.size()];
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus)
+        CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+} // namespace Numa
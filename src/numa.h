@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Spreads the search threads over the NUMA nodes and keeps each one on its
+// node, so the tables a thread allocates itself are first touched, and stay,
+// in its local memory. Only Linux exposes the topology (through sysfs), on
+// other systems every machine looks like a single node and nothing is pinned.
+namespace Numa {
+
+enum class Policy { Auto, Pin, None };
+
+// auto pins only on machines with more than one node
+inline Policy policy = Policy::Auto;
+
+/// @brief CPUs of every node, read once from /sys/devices/system/node
+const std::vector<std::vector<int>> &nodes();
+
+/// @brief parses the value of the NumaPolicy option, false if it is unknown
+bool set_policy(const std::string &name);
+
+/// @brief binds the calling thread to the node of thread `index` out of
+/// `threads`, call it before the thread allocates its search state
+void bind_thread(int index, int threads);
+
+} // namespace Numa
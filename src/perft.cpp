@@ -0,0 +1,135 @@
+#include "perft.h"
+#include "misc.h"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Shared by all perft threads without locks. The key is stored xored with
+// the data, so an entry torn by a concurrent write never validates.
+class PerftTable {
+  public:
+    explicit PerftTable(int mb) : entries(static_cast<uint64_t>(mb) * 1024 * 1024 / sizeof(Entry)) {}
+
+    bool probe(U64 key, int depth, uint64_t &nodes) const {
+        const Entry &e = entries[reduce_hash(key, entries.size())];
+        const uint64_t data = e.data.load(std::memory_order_relaxed);
+
+        if ((e.key.load(std::memory_order_relaxed) ^ data) != key || (data & 0xFF) != uint64_t(depth))
+            return false;
+
+        nodes = data >> 8;
+        return true;
+    }
+
+    void store(U64 key, int depth, uint64_t nodes) {
+        Entry &e = entries[reduce_hash(key, entries.size())];
+        const uint64_t data = nodes << 8 | uint64_t(depth);
+
+        e.key.store(key ^ data, std::memory_order_relaxed);
+        e.data.store(data, std::memory_order_relaxed);
+    }
+
+  private:
+    struct Entry {
+        std::atomic<uint64_t> key{0};
+        std::atomic<uint64_t> data{0};
+    };
+
+    std::vector<Entry> entries;
+};
+
+uint64_t perft(Board &board, NNUE::Net &nnue, int depth, PerftTable *tt) {
+    if (depth == 0)
+        return 1;
+
+    uint64_t nodes = 0;
+
+    if (depth >= 2 && tt && tt->probe(board.hashKey, depth, nodes))
+        return nodes;
+
+    Movelist list;
+    Movegen::legalmoves<ALL>(board, list);
+
+    // Bulk counting, the leaves are never made
+    if (depth == 1)
+        return list.size;
+
+    for (int i = 0; i < list.size; i++) {
+        board.makeMove<false>(list[i].move, nnue);
+        nodes += perft(board, nnue, depth - 1, tt);
+        board.unmakeMove<false>(list[i].move, nnue);
+    }
+
+    if (tt)
+        tt->store(board.hashKey, depth, nodes);
+
+    return nodes;
+}
+
+} // namespace
+
+uint64_t StartPerft(const Board &board, int depth, int threads, int hash_mb, bool divide) {
+    auto start = misc::tick();
+
+    std::unique_ptr<PerftTable> tt;
+    if (hash_mb > 0)
+        tt = std::make_unique<PerftTable>(hash_mb);
+
+    // makeMove<false> never touches the accumulators, one net serves every thread
+    auto nnue = std::make_unique<NNUE::Net>();
+
+    Board root = board;
+    Movelist moves;
+    Movegen::legalmoves<ALL>(root, moves);
+
+    std::vector<uint64_t> counts(moves.size, 0);
+    std::atomic<int> next_move = 0;
+
+    auto worker = [&]() {
+        Board local = root;
+
+        for (int i = next_move++; i < moves.size; i = next_move++) {
+            local.makeMove<false>(moves[i].move, *nnue);
+            counts[i] = perft(local, *nnue, depth - 1, tt.get());
+            local.unmakeMove<false>(moves[i].move, *nnue);
+        }
+    };
+
+    uint64_t nodes = 1;
+
+    if (depth > 0) {
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads; i++)
+            pool.emplace_back(worker);
+
+        worker();
+
+        for (auto &th : pool)
+            th.join();
+
+        nodes = 0;
+        for (int i = 0; i < moves.size; i++) {
+            nodes += counts[i];
+
+            if (divide)
+                std::cout << convertMoveToUci(moves[i].move) << ": " << counts[i] << "\n";
+        }
+    }
+
+    auto elapsed = misc::tick() - start;
+
+    if (divide)
+        std::cout << "\n";
+
+    printf("Nodes: %llu Time: %llu ms NPS: %llu Sliders: %s\n", static_cast<unsigned long long>(nodes),
+           static_cast<unsigned long long>(elapsed),
+           static_cast<unsigned long long>(1000.0 * nodes / (elapsed + 1)), Chess_Lookup::Sliders::Backend);
+    std::cout << std::flush;
+
+    return nodes;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include "search.h"
+
+/// @brief counts the leaves of the legal move tree, depth 1 nodes are bulk
+/// counted from the move list, so only movegen and makeMove<false> are timed
+/// @param threads root moves are split across this many threads
+/// @param hash_mb perft hash table size, 0 disables it
+/// @param divide print the node count below every root move
+/// @return total leaf nodes
+uint64_t StartPerft(const Board& board, int depth, int threads, int hash_mb, bool divide);
@@ -3,12 +3,15 @@
 #include "eval.h"
 #include "fancyterminal.h"
 #include "misc.h"
+#include "movepicker.h"
 #include "movescore.h"
 #include "see.h"
+#include "syzygy.h"
 
 #include <cmath>
 #include <cstring>
 #include <iostream>
+#include <thread>
 
 int lmr_table[MAXDEPTH][64];
 int lmp_table[2][8];
@@ -99,7 +102,10 @@ int qsearch(int alpha, int beta, SearchThread& st, SearchStack *ss)
     /* Probe Tranpsosition Table */
     bool ttHit = false;
     bool is_pvnode = (beta - alpha) > 1;
-    TTEntry &tte = table->probe_entry(st.board.hashKey, ttHit, ss->ply);
+    TTEntry &tte = st.tt->probe_entry(st.board.hashKey, ttHit, ss->ply);
+
+    st.tt_probes++;
+    st.tt_hits += ttHit;
 
     const int tt_score = ttHit ? score_from_tt(tte.get_score(), ss->ply) : 0;
 
@@ -108,7 +114,10 @@ int qsearch(int alpha, int beta, SearchThread& st, SearchStack *ss)
     {
         if ((tte.flag == HFALPHA && tt_score <= alpha) || (tte.flag == HFBETA && tt_score >= beta) ||
             (tte.flag == HFEXACT))
+        {
+            st.stats.prune(PRUNE_TT, 0);
             return tt_score;
+        }
     }
 
     /* Move generation */
@@ -122,38 +131,34 @@ int qsearch(int alpha, int beta, SearchThread& st, SearchStack *ss)
 
     Move bestmove = NO_MOVE;
 
-    /* Generate moves */
-    Movelist list;
-    Movegen::legalmoves<CAPTURE>(st.board, list);
-
-    /* Score moves */
-    score_moves(st.board, list, tte.move);
+    /* Captures and promotions are handed out one by one, starting with the TT move */
+    MovePicker picker(st, ss, ttHit ? tte.move : NO_MOVE, true);
+    Move move;
 
     /* Moves loop */
-    for (int i = 0; i < list.size; i++)
+    while ((move = picker.next_move(false)) != NO_MOVE)
     {
-        /* Pick next move with highest score */
-        pick_nextmove(i, list);
-
-        Move move = list[i].move;
-        ss->moved_piece = st.board.pieceAtB(to(move));
+        ss->moved_piece = st.board.pieceAtB(from(move));
 
         /* SEE pruning in qsearch search */
-        /* If we do not SEE a good capture move, we can skip the move.*/
-        if (list[i].value < GoodCaptureScore && move_count >= 1)
+        /* If we do not SEE a good capture move, we can skip the move. Only
+         * losing captures are left once the picker reaches them. */
+        if (picker.stage == PICK_BAD_NOISY && move_count >= 1)
         {
-            continue;
+            st.stats.prune(PRUNE_QS_SEE, 0);
+            break;
         }
 
         ss->continuationHistory = &st.continuationHistory[ss->moved_piece][to(move)];
 
         /* Make move on board */
         st.makeMove<true>(move);
-        table->prefetch_tt(st.board.hashKey);
+        st.tt->prefetch_tt(st.board.hashKey);
 
         /* Increment ply, nodes and movecount */
         (ss + 1)->ply = ss->ply + 1;
         st.nodes_reached++;
+        st.stats.qnode();
         move_count++;
 
         ss->move = move;
@@ -196,7 +201,7 @@ int qsearch(int alpha, int beta, SearchThread& st, SearchStack *ss)
     int flag = bestscore >= beta ? HFBETA : HFALPHA;
 
     /* Store transposition table entry */
-    table->store(st.board.hashKey, flag, bestmove, 0, score_to_tt(bestscore, ss->ply), standing_pat, ss->ply, is_pvnode);
+    st.tt->store(st.board.hashKey, flag, bestmove, 0, score_to_tt(bestscore, ss->ply), standing_pat, ss->ply, is_pvnode);
 
     /* Return bestscore achieved */
     return bestscore;
@@ -224,7 +229,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
     /* Initialize helper variables */
     bool is_root = (ss->ply == 0);
-    bool in_check = board.isSquareAttacked(~board.sideToMove, board.KingSQ(board.sideToMove));
+    bool in_check = board.inCheck();
     bool is_pvnode = (beta - alpha) > 1;
     bool improving = false;
     int eval = 0;
@@ -258,7 +263,10 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
     /* Probe transposition table */
     bool ttHit = false;
-    TTEntry &tte = table->probe_entry(board.hashKey, ttHit, ss->ply);
+    TTEntry &tte = st.tt->probe_entry(board.hashKey, ttHit, ss->ply);
+
+    st.tt_probes++;
+    st.tt_hits += ttHit;
 
     const Move excluded_move = ss->excluded;
     const int tt_score = ttHit ? score_from_tt(tte.get_score(), ss->ply) : 0;
@@ -275,7 +283,31 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
     {
         if ((tte.flag == HFALPHA && tt_score <= alpha) || (tte.flag == HFBETA && tt_score >= beta) ||
             (tte.flag == HFEXACT))
+        {
+            st.stats.prune(PRUNE_TT, depth);
             return tt_score;
+        }
+    }
+
+    /* Tablebase probe. Wins and losses are bounds, the search may still find a
+     * quicker mate, draws are exact. */
+    if (!is_root && !excluded_move && Syzygy::Largest && Syzygy::can_probe(board, depth))
+    {
+        const Syzygy::WDL wdl = Syzygy::probe_wdl(board);
+
+        if (wdl != Syzygy::WDL_FAILED)
+        {
+            st.tb_hits++;
+
+            const int tb_score = wdl == Syzygy::WDL_WIN ? TB_WIN_SCORE - ss->ply : wdl == Syzygy::WDL_LOSS ? -TB_WIN_SCORE + ss->ply : 0;
+            const int tb_flag = wdl == Syzygy::WDL_WIN ? HFBETA : wdl == Syzygy::WDL_LOSS ? HFALPHA : HFEXACT;
+
+            if (tb_flag == HFEXACT || (tb_flag == HFBETA && tb_score >= beta) || (tb_flag == HFALPHA && tb_score <= alpha))
+            {
+                st.tt->store(board.hashKey, tb_flag, NO_MOVE, std::min(MAXPLY, depth + 6), score_to_tt(tb_score, ss->ply), VALUE_NONE, ss->ply, is_pvnode);
+                return tb_score;
+            }
+        }
     }
 
     /* Set static evaluation and evaluation to our current evaluation of the
@@ -283,7 +315,9 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
     /* We can use the tt entry's evaluation if we have a tt hit so we don't have
      * to re-evaluate from scratch */
 
-    ss->static_eval = eval = ttHit ? tte.get_eval() : evaluate(st);
+    /* The TT keeps the raw eval, the pawn correction history is applied on top */
+    const int raw_eval = ttHit && tte.get_eval() != VALUE_NONE ? tte.get_eval() : evaluate(st);
+    ss->static_eval = eval = correctedEval(st, raw_eval);
 
     /* If we our static evaluation is better than what it was 2 plies ago, we
      * are improving */
@@ -315,6 +349,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
          */
         if (depth < 9 && eval >= beta && eval - ((depth - improving) * 77) - (ss - 1)->stat_score/400 >= beta)
         {
+            st.stats.prune(PRUNE_RFP, depth);
             return eval;
         }
 
@@ -329,7 +364,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
             int R = 3 + depth / 3 + std::min(3, (eval - beta) / 180);
 
-            ss->continuationHistory = &st.continuationHistory[None][0];
+            ss->continuationHistory = &st.nullContinuationHistory;
 
             board.makeNullMove();
             ss->move = NULL_MOVE;
@@ -355,6 +390,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
                     score = beta;
                 }
 
+                st.stats.prune(PRUNE_NMP, depth);
                 return score;
             }
         }
@@ -363,19 +399,16 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
         int rbeta = std::min(beta + 100, ISMATE - MAXPLY - 1);
         if (depth >= probcut_depth && abs(beta) < ISMATE && (!ttHit || eval >= rbeta || tte.depth < depth - 3))
         {
-            Movelist list;
-            Movegen::legalmoves<CAPTURE>(board, list);
-            score_moves(st, list, ss, tte.move);
+            MovePicker picker(st, ss, NO_MOVE, true);
+            Move move;
             int score = 0;
-            for (int i = 0; i < list.size; i++)
+            while ((move = picker.next_move(false)) != NO_MOVE)
             {
-                pick_nextmove(i, list);
-                Move move = list[i].move;
                 ss->moved_piece = board.pieceAtB(from(move));
 
-                if (list[i].value < GoodCaptureScore)
+                if (picker.stage == PICK_BAD_NOISY)
                 {
-                    continue;
+                    break;
                 }
 
                 if (move == tte.move)
@@ -398,7 +431,8 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
                 if (score >= rbeta)
                 {
-                    table->store(board.hashKey, HFBETA, move, depth - 3, score, ss->static_eval, ss->ply, is_pvnode);
+                    st.tt->store(board.hashKey, HFBETA, move, depth - 3, score, raw_eval, ss->ply, is_pvnode);
+                    st.stats.prune(PRUNE_PROBCUT, depth);
                     return score;
                 }
             }
@@ -406,6 +440,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
         // Razoring
         if (eval - 63 + 182 * depth <= alpha){
+            st.stats.prune(PRUNE_RAZORING, depth);
             return qsearch(alpha, beta, st, ss);
         }
     }
@@ -421,25 +456,18 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
     Move bestmove = NO_MOVE;
 
     // Move generation
-    // Generate all legal moves for current position
-    Movelist list;
-    Movegen::legalmoves<ALL>(board, list);
-
-    Movelist quietList;   // Quiet moves list
+    // Moves are generated and scored stage by stage, only as far as needed
+    MovePicker picker(st, ss, ttHit ? tte.move : NO_MOVE, false);
+    Move move;
 
-    // Score moves and pass the tt move so it can be sorted highest
-    score_moves(st, list, ss, tte.move);
+    SearchedMoves quietList;   // Quiet moves list
 
     bool skip_quiet_moves = false;
 
     // Moves loop
-    for (int i = 0; i < list.size; i++)
+    while ((move = picker.next_move(skip_quiet_moves)) != NO_MOVE)
     {
-        // Pick move with highest possible score
-        pick_nextmove(i, list);
-
         // Initialize move variable
-        Move move = list[i].move;
         Piece moved_piece = board.pieceAtB(from(move));
         ss->moved_piece = moved_piece;
 
@@ -447,6 +475,10 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
         if (move == excluded_move)
             continue;
 
+        // and root moves that would spoil the tablebase result
+        if (is_root && st.root_moves.size && st.root_moves.find(move) == -1)
+            continue;
+
         bool is_quiet = (!promoted(move) && !is_capture(board, move));
         int extension = 0;
         
@@ -477,24 +509,28 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
                 // If we have searched many moves, we can skip the rest.
                 if (!in_check && !is_pvnode && depth <= 7 && quietList.size >= lmp_table[improving][depth])
                 {
+                    st.stats.prune(PRUNE_LMP, depth);
                     skip_quiet_moves = true;
                     continue;
                 }
 
                 // Continuation pruning
                 if (lmrDepth < 3 && history < -4000 * depth){
+                    st.stats.prune(PRUNE_HISTORY, depth);
                     continue;
                 }
 
                 // Futility pruning
                 if (lmrDepth <= 6 && !in_check && eval + 217 + 71 * depth <= alpha)
                 {
+                    st.stats.prune(PRUNE_FUTILITY, depth);
                     skip_quiet_moves = true;
                 }
 
                 // See pruning for quiets
                 if (depth <= 8 && !see(board, move, -70 * depth))
                 {
+                    st.stats.prune(PRUNE_SEE_QUIET, depth);
                     continue;
                 }
             }
@@ -503,6 +539,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
                 // See pruning for noisy
                 if (depth <= 6 && !see(board, move, -15 * depth * depth))
                 {
+                    st.stats.prune(PRUNE_SEE_NOISY, depth);
                     continue;
                 }
 
@@ -535,6 +572,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
             }
             else if (singular_beta >= beta)
             {
+                st.stats.prune(PRUNE_MULTICUT, depth);
                 return (singular_beta); // Multicut
             }
             else if (tt_score >= beta)
@@ -552,9 +590,12 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
         ss->continuationHistory = &st.continuationHistory[ss->moved_piece][to(move)];
 
+        // Nodes below this root move feed the time manager
+        const uint64_t nodes_before = st.nodes_reached;
+
         /* Make move on current board. */
         st.makeMove<true>(move);
-        table->prefetch_tt(board.hashKey); // TT Prefetch
+        st.tt->prefetch_tt(board.hashKey); // TT Prefetch
 
         /* Set stack move to current move */
         ss->move = move;
@@ -606,6 +647,8 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
             /* We do a full depth research if our score beats alpha. */
             do_fullsearch = score > alpha && reduction != 1;
 
+            if (do_fullsearch) st.stats.lmr_research();
+
             bool deeper = score > bestscore + 70 + 12 * (new_depth - reduction);
 
             new_depth += deeper;
@@ -618,6 +661,7 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
         // Principal Variation Search (PVS)
         if (is_pvnode && (move_count == 1 || (score > alpha && score < beta))) {
+            if (move_count > 1) st.stats.pvs_research();
             score = -negamax(-beta, -alpha, new_depth - 1, st, ss + 1, false);
         }
 
@@ -626,6 +670,11 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
         // Undo move on board
         st.unmakeMove<true>(move);
 
+        if (is_root && st.is_main())
+        {
+            st.tm.add_root_nodes(move, st.nodes_reached - nodes_before);
+        }
+
         if (st.info.stopped && !is_root)
         {
             return 0;
@@ -648,9 +697,15 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
                         ss->killers[1] = ss->killers[0];
                         ss->killers[0] = move;
 
+                        // Update counter move
+                        if ((ss - 1)->move != NO_MOVE && (ss - 1)->move != NULL_MOVE) {
+                            st.counterMoves[(ss - 1)->moved_piece][to((ss - 1)->move)] = move;
+                        }
+
                         // Update histories
                         updateHistories(st, ss, bestmove, quietList, depth);
                     }
+                    st.stats.cutoff(move_count);
                     break;
                 }
                 // clang-format on
@@ -672,7 +727,15 @@ int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, b
 
     if (excluded_move == NO_MOVE)
     {
-        table->store(board.hashKey, flag, bestmove, depth, score_to_tt(bestscore, ss->ply), ss->static_eval, ss->ply, is_pvnode);
+        st.tt->store(board.hashKey, flag, bestmove, depth, score_to_tt(bestscore, ss->ply), raw_eval, ss->ply, is_pvnode);
+    }
+
+    /* Learn the static eval error from quiet positions whose score bound
+     * actually tells us which way the eval was wrong. */
+    if (!in_check && !excluded_move && !st.info.stopped && (bestmove == NO_MOVE || (!promoted(bestmove) && !is_capture(board, bestmove))) &&
+        !(flag == HFBETA && bestscore <= ss->static_eval) && !(flag == HFALPHA && bestscore >= ss->static_eval))
+    {
+        updateCorrectionHistory(st, depth, bestscore - ss->static_eval);
     }
 
     if (alpha != oldAlpha)
@@ -715,7 +778,7 @@ static void getPvLines(SearchThread& st, std::vector<U64> &positions, Move bestm
         return;
     }
 
-    auto pvMove = table->probeMove(st.board.hashKey);
+    auto pvMove = st.tt->probeMove(st.board.hashKey);
 
     if (pvMove && moveExists(st.board, pvMove))
     {
@@ -736,6 +799,154 @@ static void getPvLines(SearchThread& st, std::vector<U64> &positions, Move bestm
     return;
 }
 
+// The expected reply to bestmove, taken from the TT, for the GUI to ponder on
+static Move get_ponder_move(SearchThread& st, Move bestmove)
+{
+    if (bestmove == NO_MOVE)
+    {
+        return NO_MOVE;
+    }
+
+    st.makeMove<false>(bestmove);
+
+    Move ponder_move = st.tt->probeMove(st.board.hashKey);
+    if (ponder_move && !moveExists(st.board, ponder_move))
+    {
+        ponder_move = NO_MOVE;
+    }
+
+    st.unmakeMove<false>(bestmove);
+
+    return ponder_move;
+}
+
+uint64_t total_nodes(SearchThread& st)
+{
+    uint64_t nodes = st.nodes_reached;
+
+    for (auto worker : st.info.workers)
+    {
+        nodes += worker->nodes_reached;
+    }
+
+    return nodes;
+}
+
+static uint64_t total_tbhits(SearchThread& st)
+{
+    uint64_t hits = st.tb_hits;
+
+    for (auto worker : st.info.workers)
+    {
+        hits += worker->tb_hits;
+    }
+
+    return hits;
+}
+
+/* Lazy SMP helpers skip depths in a staggered pattern so the threads don't
+ * all search the same iteration at the same time. Idea from Stockfish. */
+static constexpr int skip_size[20] = {1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4};
+static constexpr int skip_phase[20] = {0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7};
+
+static inline bool skip_depth(SearchThread& st, int depth)
+{
+    if (st.is_main())
+    {
+        return false;
+    }
+
+    int i = (st.thread_id - 1) % 20;
+    return ((depth + skip_phase[i]) / skip_size[i]) % 2;
+}
+
+/* Pick the final move by letting every thread vote for its best move,
+ * weighted by the depth it completed and how good its score was. */
+static SearchThread& best_thread(SearchThread& st)
+{
+    SearchThread* best = &st;
+
+    if (st.info.workers.empty())
+    {
+        return *best;
+    }
+
+    int min_score = st.completed_score;
+    for (auto worker : st.info.workers)
+    {
+        min_score = std::min(min_score, worker->completed_score);
+    }
+
+    std::vector<std::pair<Move, int64_t>> votes;
+
+    auto vote = [&](SearchThread& th) {
+        if (th.completed_move == NO_MOVE)
+        {
+            return;
+        }
+
+        int64_t weight = int64_t(th.completed_score - min_score + 14) * th.completed_depth;
+
+        for (auto& v : votes)
+        {
+            if (v.first == th.completed_move)
+            {
+                v.second += weight;
+                return;
+            }
+        }
+
+        votes.emplace_back(th.completed_move, weight);
+    };
+
+    vote(st);
+    for (auto worker : st.info.workers)
+    {
+        vote(*worker);
+    }
+
+    auto votes_for = [&](Move move) {
+        for (auto& v : votes)
+        {
+            if (v.first == move)
+            {
+                return v.second;
+            }
+        }
+        return int64_t(0);
+    };
+
+    for (auto worker : st.info.workers)
+    {
+        if (worker->completed_move == NO_MOVE)
+        {
+            continue;
+        }
+
+        // Always prefer the shortest mate found by any thread
+        if (worker->completed_score >= IS_MATE_IN_MAX_PLY)
+        {
+            if (worker->completed_score > best->completed_score)
+            {
+                best = worker;
+            }
+            continue;
+        }
+
+        if (best->completed_score >= IS_MATE_IN_MAX_PLY)
+        {
+            continue;
+        }
+
+        if (votes_for(worker->completed_move) > votes_for(best->completed_move))
+        {
+            best = worker;
+        }
+    }
+
+    return *best;
+}
+
 // Explicit template instantiation
 template void iterative_deepening<false>(SearchThread& st);
 template void iterative_deepening<true>(SearchThread& st);
@@ -745,17 +956,37 @@ void iterative_deepening(SearchThread& st)
 {
     SearchInfo& info = st.info;
 
-    st.clear();
+    st.new_search();
     st.initialize();
-    table->nextAge();
+
+    if (st.is_main() && info.age_tt)
+    {
+        st.tt->nextAge();
+    }
 
     int score = 0;
 
     auto startime = st.start_time();
     Move bestmove = NO_MOVE;
 
+    // Expected reply to the best move, read while that iteration's PV is still in the TT
+    Move ponder_move = NO_MOVE;
+    Move ponder_bestmove = NO_MOVE;
+
+    // In a tablebase position DTZ decided which root moves keep the result
+    // (ThreadHandler::start), the search then only picks among those
+    if (st.is_main() && st.root_moves.size)
+    {
+        st.tb_hits++;
+    }
+
     for (int current_depth = 1; current_depth <= info.depth; current_depth++)
     {
+        if (skip_depth(st, current_depth))
+        {
+            continue;
+        }
+
         score = aspiration_window(score, current_depth, st, bestmove);
 
         if (st.info.stopped || st.stop_early())
@@ -764,15 +995,37 @@ void iterative_deepening(SearchThread& st)
         }
         
         bestmove = st.bestmove;
+
+        st.completed_depth = current_depth;
+        st.completed_score = score;
+        st.completed_move = bestmove;
+
+        if (!st.is_main())
+        {
+            continue;
+        }
+
         info.score = score;
 
         if (info.timeset)
         {
-            st.tm.update_tm(bestmove);
+            st.tm.update_tm(bestmove, st.nodes_reached, current_depth);
         }
 
         if constexpr (print_info)
         {
+            Move reply = get_ponder_move(st, bestmove);
+            if (reply != NO_MOVE || bestmove != ponder_bestmove)
+            {
+                ponder_move = reply;
+                ponder_bestmove = bestmove;
+            }
+        }
+
+        if constexpr (print_info)
+        {
+            uint64_t nodes = total_nodes(st);
+
             if (info.uci)
             {
                 auto time_elapsed = misc::tick() - startime;
@@ -788,9 +1041,15 @@ void iterative_deepening(SearchThread& st)
                 }
                 
                 std::cout << " depth " << current_depth;
-                std::cout << " nodes " << st.nodes_reached;
-                std::cout << " nps " << static_cast<int>(1000.0f * st.nodes_reached / (time_elapsed + 1));
+                std::cout << " nodes " << nodes;
+                std::cout << " nps " << static_cast<uint64_t>(1000.0f * nodes / (time_elapsed + 1));
                 std::cout << " time " << static_cast<uint64_t>(time_elapsed);
+
+                if (Syzygy::Largest)
+                {
+                    std::cout << " tbhits " << total_tbhits(st);
+                }
+
                 std::cout << " pv";
 
                 std::vector<uint64_t> positions;
@@ -803,8 +1062,8 @@ void iterative_deepening(SearchThread& st)
                 auto time_elapsed = misc::tick() - startime;
 
                 printf("[%2d/%2d] > eval: %-4.2f nodes: %6.2fM speed: %-5.2f MNPS", current_depth, info.depth,
-                       static_cast<float>(score / 100.0f), static_cast<float>(st.nodes_reached / 1000000.0f),
-                       static_cast<float>(1000.0f * st.nodes_reached / (time_elapsed + 1)) / 1000000.0f);
+                       static_cast<float>(score / 100.0f), static_cast<float>(nodes / 1000000.0f),
+                       static_cast<float>(1000.0f * nodes / (time_elapsed + 1)) / 1000000.0f);
 
                 std::vector<uint64_t> positions;
                 getPvLines(st, positions, bestmove);
@@ -813,9 +1072,53 @@ void iterative_deepening(SearchThread& st)
         }
     }
 
+    if (!st.is_main())
+    {
+        info.active_workers--;
+        return;
+    }
+
+    // A finished ponder or infinite search may not answer before ponderhit or stop
+    while ((info.ponder || info.infinite) && !info.stopped)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (!info.workers.empty())
+    {
+        // Stop the helpers and wait until all of them are done with their iteration
+        info.stopped = true;
+
+        while (info.active_workers > 0)
+        {
+            std::this_thread::yield();
+        }
+
+        bestmove = best_thread(st).completed_move;
+    }
+
+    if (bestmove == NO_MOVE)
+    {
+        bestmove = st.bestmove;
+    }
+
+    info.bestmove = bestmove;
+
     if (print_info)
     {
-        std::cout << "bestmove " << convertMoveToUci(bestmove) << std::endl;
+        std::cout << "bestmove " << (bestmove == NO_MOVE ? "0000" : convertMoveToUci(bestmove));
+
+        if (bestmove != ponder_bestmove || ponder_move == NO_MOVE)
+        {
+            ponder_move = get_ponder_move(st, bestmove);
+        }
+
+        if (ponder_move != NO_MOVE)
+        {
+            std::cout << " ponder " << convertMoveToUci(ponder_move);
+        }
+
+        std::cout << std::endl;
     }
 }
 
@@ -843,11 +1146,13 @@ int aspiration_window(int prevEval, int depth, SearchThread& st, Move& bestmove)
 
         score = negamax(alpha, beta, depth, st, ss, false);
 
-        if (st.stop_early())
+        if (st.info.stopped || st.stop_early())
         {
             break;
         }
 
+        st.stats.aspiration(score, alpha, beta);
+
         if (score <= alpha)
         {
             beta = (alpha + beta) / 2;
@@ -873,5 +1178,11 @@ int aspiration_window(int prevEval, int depth, SearchThread& st, Move& bestmove)
         delta += delta / 2;
     }
 
+    // A falling score asks for more time in update_tm
+    if (initial_depth > 3 && !st.info.stopped)
+    {
+        st.tm.score_drop = std::max(0, prevEval - score);
+    }
+
     return score;
 }
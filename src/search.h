@@ -1,28 +1,62 @@
 #pragma once
 
 #include "misc.h"
+#include "searchstats.h"
 #include "tt.h"
 #include "types.h"
 #include "timeman.h"
 
 #include <memory>
+#include <vector>
 
 // Global Transposition Table
 extern TranspositionTable *table;
 
 using HistoryTable = std::array<std::array<int16_t, 64>, 13>;
-using ContinuationHistoryTable = std::array<std::array<std::array<std::array<int16_t, 64>, 13>, 64>, 13>;
+// History of a move following a previous one, by the current move's piece and target square.
+// Only real pieces move, so unlike the main history there is no slot for None.
+using PieceToHistory = std::array<std::array<int16_t, 64>, 12>;
+using ContinuationHistoryTable = std::array<std::array<PieceToHistory, 64>, 12>;
+
+// Static eval error by side to move and pawn structure
+constexpr int CORRECTION_HISTORY_SIZE = 16384;
+using CorrectionHistoryTable = std::array<std::array<int16_t, CORRECTION_HISTORY_SIZE>, 2>;
+
+// Probcut removes at least 4 plies of depth for every move it makes at the same
+// ply. The check, singular and "deeper" extensions can stack to add at most 3
+// per ply, so this bounds the moves on a path
+static_assert(ACCUMULATOR_STACK_SIZE > MAXPLY + 1 + (MAXDEPTH + 3 * MAXPLY) / 4,
+              "the NNUE accumulator stack is too small for MAXPLY");
+
+struct SearchThread;
 
 struct SearchInfo {
     int32_t score = 0;
     uint8_t depth = 0;
 
+    // Move the last search played, after the threads voted
+    Move bestmove = NO_MOVE;
+
     std::atomic<uint64_t> nodes = 0;
 
     std::atomic<bool> timeset = 0;
     std::atomic<bool> stopped = 0;
     std::atomic<bool> nodeset = 0;
     std::atomic<bool> uci = 0;
+
+    // Searching the predicted reply on the opponent's time, the clock only
+    // starts to count once ponderhit clears this
+    std::atomic<bool> ponder = 0;
+
+    // go infinite, bestmove waits for stop even if the search runs out of depth
+    std::atomic<bool> infinite = 0;
+
+    // Only one search may age a shared TT, batch analysis runs many at once
+    bool age_tt = true;
+
+    // Lazy SMP helpers searching alongside the main thread
+    std::vector<SearchThread*> workers;
+    std::atomic<int> active_workers = 0;
 };
 
 struct SearchStack {
@@ -38,13 +72,36 @@ struct SearchStack {
 
     int stat_score = 0;
 
-    HistoryTable* continuationHistory;
+    PieceToHistory* continuationHistory;
+};
+
+// Moves already searched in a node. Their ordering scores aren't needed, so
+// only the moves are kept instead of a full Movelist.
+struct SearchedMoves {
+    Move list[MAX_MOVES];
+    uint8_t size = 0;
+
+    inline void Add(Move move) {
+        list[size++] = move;
+    }
+
+    inline Move operator[](int i) const {
+        return list[i];
+    }
 };
 
 struct SearchThread{
 
     HistoryTable searchHistory;
-    HistoryTable continuationHistory[13][64];
+    ContinuationHistoryTable continuationHistory;
+
+    // Continuation history of the moves after a null move
+    PieceToHistory nullContinuationHistory;
+
+    // Quiet reply that refuted the previous move, by its piece and target square
+    Move counterMoves[13][64];
+
+    CorrectionHistoryTable pawnCorrectionHistory;
 
     NNUE::Net nnue;
 
@@ -52,19 +109,78 @@ struct SearchThread{
     TimeMan tm;
     SearchInfo& info;
 
+    // The global table unless the thread was given a private one
+    TranspositionTable* tt = table;
+
     uint64_t nodes_reached = 0;
 
+    // TT probes of the last search and how many of them found the position
+    uint64_t tt_probes = 0;
+    uint64_t tt_hits = 0;
+
+    // Pruning and move ordering counters, empty unless built with STATS=yes
+    SearchStats stats;
+
+    // Successful tablebase probes
+    uint64_t tb_hits = 0;
+
+    // 0 is the main thread, helpers are numbered from 1
+    int thread_id = 0;
+
     Move bestmove = NO_MOVE;
 
+    // Root moves that keep the tablebase result, empty when every move is searched.
+    // Set by ThreadHandler::start, threads that are searched directly leave it empty.
+    Movelist root_moves;
+
+    // Result of the last completed iteration, used for thread voting
+    int completed_depth = 0;
+    int completed_score = 0;
+    Move completed_move = NO_MOVE;
+
     SearchThread(SearchInfo& i) : info(i), board(DEFAULT_POS, nnue){
         clear();
     }
 
+    inline bool is_main() const {
+        return thread_id == 0;
+    }
+
+    // New game, forget everything learned so far
     inline void clear(){
+        memset(searchHistory.data(), 0, sizeof(searchHistory));
+        memset(continuationHistory.data(), 0, sizeof(continuationHistory));
+        memset(nullContinuationHistory.data(), 0, sizeof(nullContinuationHistory));
+        memset(counterMoves, 0, sizeof(counterMoves));
+        memset(pawnCorrectionHistory.data(), 0, sizeof(pawnCorrectionHistory));
+
+        reset();
+    }
+
+    // Next search of the same game, the histories are kept. Only the butterfly
+    // history is aged, the continuation, counter move and correction tables
+    // carry over as they are until clear().
+    inline void new_search(){
+        for (auto& piece : searchHistory){
+            for (auto& h : piece){
+                h /= 2;
+            }
+        }
+
+        reset();
+    }
+
+    inline void reset(){
         nodes_reached = 0;
+        tt_probes = 0;
+        tt_hits = 0;
+        tb_hits = 0;
+        stats.clear();
 
-        memset(searchHistory.data(), 0, sizeof(searchHistory));
-        memset(continuationHistory, 0, sizeof(continuationHistory));
+        bestmove = NO_MOVE;
+        completed_depth = 0;
+        completed_score = 0;
+        completed_move = NO_MOVE;
 
         board.refresh(nnue);
 
@@ -74,7 +190,7 @@ struct SearchThread{
     inline void initialize(){
         tm.start_time = misc::tick();
 
-        if (info.timeset)
+        if (is_main() && info.timeset)
         {
             tm.set_time(board.sideToMove);
         }
@@ -99,6 +215,7 @@ struct SearchThread{
     // To make moves from UCI string.
     inline void makeMove(std::string& move_uci){
         board.makeMove<false>(convertUciToMove(board, move_uci), nnue);
+        board.trimHistory();
     }
 
     // Applying fen on board
@@ -108,7 +225,7 @@ struct SearchThread{
 
     inline bool stop_early()
     {
-        if (info.timeset && (tm.stop_search() || info.stopped))
+        if (is_main() && info.timeset && !info.ponder && (tm.stop_search() || info.stopped))
         {
             return true;
         }
@@ -120,10 +237,28 @@ struct SearchThread{
 
     void check_time()
     {
-        if ((info.timeset && tm.check_time()) || (info.nodeset && nodes_reached >= info.nodes))
+        // Only the main thread manages time
+        if (is_main() && info.timeset && !info.ponder && tm.check_time())
         {
             info.stopped = true;
         }
+
+        // The node limit counts every thread, like the nodes reported in info,
+        // and any of them may hit it
+        if (info.nodeset)
+        {
+            uint64_t nodes = nodes_reached;
+
+            for (auto worker : info.workers)
+            {
+                nodes += worker->nodes_reached;
+            }
+
+            if (nodes >= info.nodes)
+            {
+                info.stopped = true;
+            }
+        }
     }
 };
 
@@ -141,6 +276,8 @@ void init_search();
 
 template <bool print_info> void iterative_deepening(SearchThread& st);
 
+uint64_t total_nodes(SearchThread& st);
+
 int negamax(int alpha, int beta, int depth, SearchThread& st, SearchStack *ss, bool cutnodes);
 int qsearch(int alpha, int beta, SearchThread& st, SearchStack *ss);
 int aspiration_window(int prevEval, int depth, SearchThread& st, Move& bestmove);
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "searchstats.h"
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+namespace {
+
+constexpr const char *rule_names[PRUNE_RULES] = {"TT cut",   "RFP",      "NMP",       "Probcut",
+                                                 "Razoring", "Multicut", "LMP",       "History",
+                                                 "Futility", "SEE quiet", "SEE noisy", "QS SEE"};
+
+double percent(uint64_t part, uint64_t total) { return total ? 100.0 * part / total : 0.0; }
+
+unsigned long long ull(uint64_t value) { return static_cast<unsigned long long>(value); }
+
+} // namespace
+
+SearchStats &SearchStats::operator+=(const SearchStats &other) {
+    qnodes += other.qnodes;
+
+    for (int i = 0; i < MOVE_INDICES; i++)
+        cutoffs[i] += other.cutoffs[i];
+
+    for (int rule = 0; rule < PRUNE_RULES; rule++)
+        for (int depth = 0; depth < DEPTHS; depth++)
+            pruned[rule][depth] += other.pruned[rule][depth];
+
+    aspiration_searches += other.aspiration_searches;
+    fail_lows += other.fail_lows;
+    fail_highs += other.fail_highs;
+
+    lmr_researches += other.lmr_researches;
+    pvs_researches += other.pvs_researches;
+
+    return *this;
+}
+
+void PrintSearchStats(const SearchStats &stats, uint64_t nodes, uint64_t tt_probes, uint64_t tt_hits) {
+    if (!SearchStatsEnabled) {
+        std::cout << "Search statistics are not compiled in, build with make STATS=yes" << std::endl;
+        return;
+    }
+
+    printf("Nodes %llu, qsearch %.1f%%\n", ull(nodes), percent(stats.qnodes, nodes));
+    printf("TT probes %llu, %.1f%% hits\n", ull(tt_probes), percent(tt_hits, tt_probes));
+
+    uint64_t cutoffs = 0;
+    for (auto count : stats.cutoffs)
+        cutoffs += count;
+
+    printf("Beta cutoffs %llu, first move %.1f%%, by move index:", ull(cutoffs), percent(stats.cutoffs[0], cutoffs));
+    for (int i = 0; i < SearchStats::MOVE_INDICES; i++)
+        printf(" %.1f", percent(stats.cutoffs[i], cutoffs));
+    printf("\n");
+
+    printf("Aspiration searches %llu, %llu fail low, %llu fail high\n", ull(stats.aspiration_searches),
+           ull(stats.fail_lows), ull(stats.fail_highs));
+    printf("Re-searches %llu after LMR, %llu PVS\n", ull(stats.lmr_researches), ull(stats.pvs_researches));
+
+    printf("%-10s %10s", "Pruned", "total");
+    for (int depth = 0; depth < SearchStats::DEPTHS; depth++)
+        printf(" %8s", (std::to_string(depth) + (depth == SearchStats::DEPTHS - 1 ? "+" : "")).c_str());
+    printf("\n");
+
+    for (int rule = 0; rule < PRUNE_RULES; rule++) {
+        uint64_t total = 0;
+        for (auto count : stats.pruned[rule])
+            total += count;
+
+        printf("%-10s %10llu", rule_names[rule], ull(total));
+        for (auto count : stats.pruned[rule])
+            printf(" %8llu", ull(count));
+        printf("\n");
+    }
+
+    std::cout << std::flush;
+}
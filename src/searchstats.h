@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Counting where the nodes go costs speed, so the counters are only compiled
+// in with `make STATS=yes`. Otherwise every call below is an empty inline.
+#ifdef SEARCH_STATS
+constexpr bool SearchStatsEnabled = true;
+#else
+constexpr bool SearchStatsEnabled = false;
+#endif
+
+enum PruneRule : uint8_t {
+    PRUNE_TT,
+    PRUNE_RFP,
+    PRUNE_NMP,
+    PRUNE_PROBCUT,
+    PRUNE_RAZORING,
+    PRUNE_MULTICUT,
+    PRUNE_LMP,
+    PRUNE_HISTORY,
+    PRUNE_FUTILITY,
+    PRUNE_SEE_QUIET,
+    PRUNE_SEE_NOISY,
+    PRUNE_QS_SEE,
+    PRUNE_RULES
+};
+
+struct SearchStats {
+    // deeper nodes share the last bucket, qsearch counts as depth 0
+    static constexpr int DEPTHS = 12;
+    static constexpr int MOVE_INDICES = 16;
+
+    uint64_t qnodes = 0;
+
+    // beta cutoffs in the moves loop by the index of the move that cut
+    uint64_t cutoffs[MOVE_INDICES]{};
+
+    uint64_t pruned[PRUNE_RULES][DEPTHS]{};
+
+    uint64_t aspiration_searches = 0;
+    uint64_t fail_lows = 0;
+    uint64_t fail_highs = 0;
+
+    uint64_t lmr_researches = 0;
+    uint64_t pvs_researches = 0;
+
+    inline void qnode() {
+        if constexpr (SearchStatsEnabled)
+            qnodes++;
+    }
+
+    inline void cutoff(int move_count) {
+        if constexpr (SearchStatsEnabled)
+            cutoffs[std::clamp(move_count - 1, 0, MOVE_INDICES - 1)]++;
+    }
+
+    inline void prune(PruneRule rule, int depth) {
+        if constexpr (SearchStatsEnabled)
+            pruned[rule][std::clamp(depth, 0, DEPTHS - 1)]++;
+    }
+
+    inline void aspiration(int score, int alpha, int beta) {
+        if constexpr (SearchStatsEnabled) {
+            aspiration_searches++;
+            fail_lows += score <= alpha;
+            fail_highs += score >= beta;
+        }
+    }
+
+    inline void lmr_research() {
+        if constexpr (SearchStatsEnabled)
+            lmr_researches++;
+    }
+
+    inline void pvs_research() {
+        if constexpr (SearchStatsEnabled)
+            pvs_researches++;
+    }
+
+    inline void clear() {
+        if constexpr (SearchStatsEnabled)
+            *this = SearchStats{};
+    }
+
+    SearchStats &operator+=(const SearchStats &other);
+};
+
+/// @brief prints the counters of one or more searches, nodes and the TT
+/// counters are always kept by the search threads and passed in separately
+void PrintSearchStats(const SearchStats &stats, uint64_t nodes, uint64_t tt_probes, uint64_t tt_hits);
@@ -1,21 +1,39 @@
 #pragma once
 
-#if defined(__AVX__) || defined(__AVX2__) || defined(__AVX512F__)
+/*
+    Vector register abstraction used by the NNUE kernels. This header is only
+    included by kernels/nnue_kernels.cpp, which is compiled once per target
+    instruction set, so everything here must have internal linkage.
+*/
+
+#include <cstdint>
+
+#if !defined(NO_SIMD)
+#if defined(__AVX512F__) && defined(__AVX512BW__)
 #include <immintrin.h>
 #define USE_SIMD
-#endif
-
-#if defined(__AVX512F__)
 #define BIT_ALIGNMENT  (512)
-#elif defined(__AVX2__) || defined(__AVX__)
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define USE_SIMD
 #define BIT_ALIGNMENT  (256)
+#elif defined(__SSE4_1__)
+#include <immintrin.h>
+#define USE_SIMD
+#define BIT_ALIGNMENT  (128)
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define USE_SIMD
+#define BIT_ALIGNMENT  (128)
+#endif
 #endif
 
+#if defined(USE_SIMD)
 #define STRIDE_16_BIT (BIT_ALIGNMENT / 16)
-#define ALIGNMENT     (BIT_ALIGNMENT / 8)
 #define REG_COUNT (16)
+#endif
 
-#if defined(__AVX512F__)
+#if defined(USE_SIMD) && BIT_ALIGNMENT == 512
 using register_type16 = __m512i;
 using register_type32 = __m512i;
 #define register_madd_epi16 _mm512_madd_epi16
@@ -24,9 +42,12 @@ using register_type32 = __m512i;
 #define register_add_epi16  _mm512_add_epi16
 #define register_sub_epi16  _mm512_sub_epi16
 #define register_max_epi16  _mm512_max_epi16
+#define register_min_epi16  _mm512_min_epi16
+#define register_mullo_epi16 _mm512_mullo_epi16
+#define register_set1_epi16 _mm512_set1_epi16
 #define register_load   _mm512_load_si512
 #define register_store  _mm512_store_si512
-#elif defined(__AVX2__) || defined(__AVX__)
+#elif defined(USE_SIMD) && BIT_ALIGNMENT == 256
 using register_type16 = __m256i;
 using register_type32 = __m256i;
 #define register_madd_epi16 _mm256_madd_epi16
@@ -37,25 +58,72 @@ using register_type32 = __m256i;
 #define register_add_epi16  _mm256_add_epi16
 #define register_sub_epi16  _mm256_sub_epi16
 #define register_max_epi16  _mm256_max_epi16
+#define register_min_epi16  _mm256_min_epi16
+#define register_mullo_epi16 _mm256_mullo_epi16
+#define register_set1_epi16 _mm256_set1_epi16
 #define avx_zero _mm256_setzero_si256
+#elif defined(USE_SIMD) && !defined(__ARM_NEON)
+using register_type16 = __m128i;
+using register_type32 = __m128i;
+#define register_madd_epi16 _mm_madd_epi16
+#define register_load   _mm_load_si128
+#define register_store  _mm_store_si128
+#define register_add_epi32  _mm_add_epi32
+#define register_sub_epi32  _mm_sub_epi32
+#define register_add_epi16  _mm_add_epi16
+#define register_sub_epi16  _mm_sub_epi16
+#define register_max_epi16  _mm_max_epi16
+#define register_min_epi16  _mm_min_epi16
+#define register_mullo_epi16 _mm_mullo_epi16
+#define register_set1_epi16 _mm_set1_epi16
+#elif defined(USE_SIMD) && defined(__ARM_NEON)
+using register_type16 = int16x8_t;
+using register_type32 = int32x4_t;
+#define register_add_epi32  vaddq_s32
+#define register_sub_epi32  vsubq_s32
+#define register_add_epi16  vaddq_s16
+#define register_sub_epi16  vsubq_s16
+#define register_max_epi16  vmaxq_s16
+#define register_min_epi16  vminq_s16
+#define register_mullo_epi16 vmulq_s16
+#define register_set1_epi16 vdupq_n_s16
 #endif
 
-
 #if defined(USE_SIMD)
-inline int32_t sumRegisterEpi32(register_type32& reg) {
-#if defined(__AVX512F__)
+// acc += pairwise sums of a * b, vpdpwssd where AVX512-VNNI is available
+static inline register_type32 register_dpwssd_epi32(register_type32 acc, register_type16 a, register_type16 b) {
+#if BIT_ALIGNMENT == 512 && defined(__AVX512VNNI__)
+    return _mm512_dpwssd_epi32(acc, a, b);
+#elif defined(__ARM_NEON)
+    acc = vmlal_s16(acc, vget_low_s16(a), vget_low_s16(b));
+    return vmlal_high_s16(acc, a, b);
+#else
+    return register_add_epi32(acc, register_madd_epi16(a, b));
+#endif
+}
+
+static inline int32_t sumRegisterEpi32(register_type32& reg) {
+#if defined(__ARM_NEON)
+    return vaddvq_s32(reg);
+#else
+#if BIT_ALIGNMENT == 512
     const __m256i reduced_8 =
-        _mm256_add_epi32(_mm512_castsi512_si256(reg), _mm512_extracti32x8_epi32(reg, 1));
-#elif defined(__AVX2__) || defined(__AVX__)
+        _mm256_add_epi32(_mm512_castsi512_si256(reg), _mm512_extracti64x4_epi64(reg, 1));
+#elif BIT_ALIGNMENT == 256
     const __m256i reduced_8 = reg;
 #endif
 
+#if BIT_ALIGNMENT >= 256
     const __m128i reduced_4 =
-        _mm_add_epi32(_mm256_castsi256_si128(reduced_8), _mm256_extractf128_si256(reduced_8, 1));
+        _mm_add_epi32(_mm256_castsi256_si128(reduced_8), _mm256_extracti128_si256(reduced_8, 1));
+#else
+    const __m128i reduced_4 = reg;
+#endif
 
     __m128i vsum = _mm_add_epi32(reduced_4, _mm_srli_si128(reduced_4, 8));
     vsum         = _mm_add_epi32(vsum, _mm_srli_si128(vsum, 4));
     int32_t sums = _mm_cvtsi128_si32(vsum);
     return sums;
+#endif
 }
-#endif
\ No newline at end of file
+#endif
@@ -879,4 +879,86 @@ namespace Chess_Lookup::Fancy {
     static constexpr uint64_t QueenAttacks(int s, uint64_t occ) {
         return RookAttacks(s, occ) | BishopAttacks(s, occ);
     }
-}
\ No newline at end of file
+}
+
+// BMI2 builds index the attack tables with PEXT instead of the magic multiply.
+// AMD CPUs before Zen 3 implement PEXT in microcode, the makefile passes
+// -DNO_PEXT for them so they keep the fancy magics.
+#if defined(__BMI2__) && !defined(NO_PEXT)
+#include <immintrin.h>
+#define USE_PEXT
+
+namespace Chess_Lookup::Pext {
+
+    struct PextEntry {
+        uint64_t* attacks;
+        uint64_t mask;
+    };
+
+    // one slot per subset of the relevant occupancy, 2^popcount(mask) per square
+    inline uint64_t rook_table[102400];
+    inline uint64_t bishop_table[5248];
+
+    inline PextEntry r_pext[64];
+    inline PextEntry b_pext[64];
+
+    // fills the tables from the fancy magics, so both backends agree exactly
+    template <bool rook>
+    inline void init_table(uint64_t* table, PextEntry* entries) {
+        for (int s = 0; s < 64; s++) {
+            const uint64_t mask = ~(rook ? Fancy::r_magics[s].mask : Fancy::b_magics[s].mask);
+
+            entries[s] = { table, mask };
+
+            uint64_t subset = 0;
+            do {
+                table[_pext_u64(subset, mask)] =
+                    rook ? Fancy::RookAttacks(s, subset) : Fancy::BishopAttacks(s, subset);
+                subset = (subset - mask) & mask;
+            } while (subset);
+
+            table += 1ULL << __builtin_popcountll(mask);
+        }
+    }
+
+    inline void init() {
+        init_table<true>(rook_table, r_pext);
+        init_table<false>(bishop_table, b_pext);
+    }
+
+    static inline uint64_t RookAttacks(int s, uint64_t occ) {
+        const PextEntry& e = r_pext[s];
+        return e.attacks[_pext_u64(occ, e.mask)];
+    }
+
+    static inline uint64_t BishopAttacks(int s, uint64_t occ) {
+        const PextEntry& e = b_pext[s];
+        return e.attacks[_pext_u64(occ, e.mask)];
+    }
+
+    static inline uint64_t QueenAttacks(int s, uint64_t occ) {
+        return RookAttacks(s, occ) | BishopAttacks(s, occ);
+    }
+}
+#endif
+
+// Attack lookup used by the engine, picked when compiling
+namespace Chess_Lookup::Sliders {
+#if defined(USE_PEXT)
+    using Pext::RookAttacks;
+    using Pext::BishopAttacks;
+    using Pext::QueenAttacks;
+
+    inline void init() { Pext::init(); }
+
+    constexpr const char* Backend = "pext";
+#else
+    using Fancy::RookAttacks;
+    using Fancy::BishopAttacks;
+    using Fancy::QueenAttacks;
+
+    inline void init() {}
+
+    constexpr const char* Backend = "fancy magics";
+#endif
+}
@@ -0,0 +1,109 @@
+#include "syzygy.h"
+
+#include <iostream>
+
+#ifdef USE_SYZYGY
+#include "tbprobe.h"
+#endif
+
+namespace Syzygy {
+
+#ifdef USE_SYZYGY
+
+namespace {
+
+unsigned ep_square(const Board &board) { return board.enPassantSquare == NO_SQ ? 0 : board.enPassantSquare; }
+
+U64 all_of(const Board &board, PieceType type) { return board.pieces(type, White) | board.pieces(type, Black); }
+
+} // namespace
+
+void init(const std::string &path) {
+    tb_free();
+    Largest = 0;
+
+    if (path.empty() || path == "<empty>")
+        return;
+
+    if (!tb_init(path.c_str())) {
+        std::cout << "info string Could not initialise Syzygy tablebases from " << path << std::endl;
+        return;
+    }
+
+    Largest = TB_LARGEST;
+    std::cout << "info string Found " << TB_LARGEST << " piece Syzygy tablebases" << std::endl;
+}
+
+WDL probe_wdl(const Board &board) {
+    const unsigned result =
+        tb_probe_wdl(board.Us<White>(), board.Us<Black>(), all_of(board, KING), all_of(board, QUEEN),
+                     all_of(board, ROOK), all_of(board, BISHOP), all_of(board, KNIGHT), all_of(board, PAWN), 0, 0,
+                     ep_square(board), board.sideToMove == White);
+
+    return result == TB_RESULT_FAILED ? WDL_FAILED : WDL(result);
+}
+
+bool probe_root(Board &board, Movelist &moves) {
+    moves.size = 0;
+
+    if (popcount(board.All()) > Largest || board.castlingRights)
+        return false;
+
+    // Result of every root move from our side, already adjusted for the 50 move rule
+    unsigned results[TB_MAX_MOVES];
+
+    const unsigned result =
+        tb_probe_root(board.Us<White>(), board.Us<Black>(), all_of(board, KING), all_of(board, QUEEN),
+                      all_of(board, ROOK), all_of(board, BISHOP), all_of(board, KNIGHT), all_of(board, PAWN),
+                      board.halfMoveClock, 0, ep_square(board), board.sideToMove == White, results);
+
+    if (result == TB_RESULT_FAILED || result == TB_RESULT_CHECKMATE || result == TB_RESULT_STALEMATE)
+        return false;
+
+    unsigned best = TB_LOSS;
+    for (int i = 0; results[i] != TB_RESULT_FAILED; i++)
+        best = std::max(best, TB_GET_WDL(results[i]));
+
+    static constexpr char promotions[] = {0, 'q', 'r', 'b', 'n'};
+
+    Movelist list;
+    Movegen::legalmoves<ALL>(board, list);
+
+    for (int i = 0; results[i] != TB_RESULT_FAILED; i++) {
+        if (TB_GET_WDL(results[i]) != best)
+            continue;
+
+        std::string uci = squareToString[TB_GET_FROM(results[i])] + squareToString[TB_GET_TO(results[i])];
+        if (TB_GET_PROMOTES(results[i]))
+            uci += promotions[TB_GET_PROMOTES(results[i])];
+
+        for (auto &ext : list) {
+            if (convertMoveToUci(ext.move) == uci) {
+                moves.Add(ext.move);
+                break;
+            }
+        }
+    }
+
+    return moves.size > 0;
+}
+
+#else
+
+void init(const std::string &path) {
+    Largest = 0;
+
+    if (!path.empty() && path != "<empty>")
+        std::cout << "info string Syzygy support is not compiled in, build with make FATHOM=<path>" << std::endl;
+}
+
+WDL probe_wdl(const Board &) { return WDL_FAILED; }
+
+bool probe_root(Board &, Movelist &moves) {
+    moves.size = 0;
+    return false;
+}
+
+#endif
+
+} // namespace Syzygy
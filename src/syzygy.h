@@ -0,0 +1,42 @@
+#pragma once
+
+#include "types.h"
+
+#include <algorithm>
+#include <string>
+
+// Syzygy tablebases are probed through Fathom, which memory maps the table
+// files once and shares them between all threads. Without a Fathom build
+// (make FATHOM=<path>) no tables are ever found and every probe fails.
+namespace Syzygy {
+
+enum WDL : int { WDL_FAILED = -1, WDL_LOSS, WDL_BLESSED_LOSS, WDL_DRAW, WDL_CURSED_WIN, WDL_WIN };
+
+// Pieces on the board of the largest table found, 0 without tables
+inline int Largest = 0;
+
+// UCI options, positions with exactly ProbeLimit pieces are only probed at depth >= ProbeDepth
+inline int ProbeDepth = 1;
+inline int ProbeLimit = 7;
+
+/// @brief loads the tables from a list of directories, an empty path or
+/// <empty> unloads them
+void init(const std::string &path);
+
+inline bool can_probe(const Board &board, int depth) {
+    const int pieces = popcount(board.All());
+    const int limit = std::min(Largest, ProbeLimit);
+
+    return pieces <= limit && (pieces < limit || depth >= ProbeDepth) && !board.halfMoveClock &&
+           !board.castlingRights;
+}
+
+/// @brief win/draw/loss of the side to move, ignoring the 50 move rule
+WDL probe_wdl(const Board &board);
+
+/// @brief collects the root moves that keep the best result with the 50 move
+/// rule in mind, using DTZ, so the search only has to pick among them
+/// @return false if the position isn't in the tables
+bool probe_root(Board &board, Movelist &moves);
+
+} // namespace Syzygy
@@ -1,52 +1,256 @@
 #pragma once
 
+#include "numa.h"
 #include "search.h"
+#include "syzygy.h"
 
+#include <condition_variable>
+#include <mutex>
 #include <vector>
 #include <thread>
 
-class Thread {
-    public:
-    std::unique_ptr<SearchThread> searchThread;
-
-    Thread(SearchInfo& info) : searchThread{std::make_unique<SearchThread>(info)} {}
-    Thread(const Thread& other) : searchThread(std::make_unique<SearchThread>(*other.searchThread)) {}
-    Thread(const SearchThread& other) : searchThread{std::make_unique<SearchThread>(other)} {}
-};
+#define MAXTHREADS 256
 
+// Search threads are created once and parked on a condition variable between
+// searches, so a go only has to wake them. Every thread, the main one included,
+// keeps its SearchThread, and with it its histories, for the whole game.
 class ThreadHandler {
-    using ThreadCount = uint8_t;
+    using ThreadCount = uint16_t;
 
     private:
-    std::vector<Thread> searchers;
+    std::vector<std::unique_ptr<SearchThread>> helpers;
     std::vector<std::thread> threads;
 
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+
+    // bumped by every start, a parked thread runs once per new generation
+    uint64_t generation = 0;
+    ThreadCount searching = 0;
+    ThreadCount ready = 0;
+    bool quit = false;
+
+    // Built by pool thread 0, the caller's SearchThread only hands it the position
+    std::unique_ptr<SearchThread> main;
+    SearchInfo* info = nullptr;
+
+    // the main thread prints search info and bestmove
+    bool print_info = true;
+
     ThreadCount thread_count = 1;
 
-    public:
-    ThreadHandler(){
+    void idle_loop(ThreadCount id, uint64_t seen){
+        // Pinned before the thread allocates its SearchThread, so its
+        // histories and accumulators are first touched on the local node
+        Numa::bind_thread(id, thread_count);
+
+        {
+            auto own = std::make_unique<SearchThread>(*info);
+            own->thread_id = id;
+
+            std::lock_guard lock(mutex);
+            if (id == 0){
+                main = std::move(own);
+            }
+            else {
+                helpers[id - 1] = std::move(own);
+            }
+
+            if (++ready == thread_count){
+                finished.notify_all();
+            }
+        }
+
+        while (true){
+            SearchThread* st;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&]{ return quit || generation != seen; });
+
+                if (quit){
+                    return;
+                }
+
+                seen = generation;
+                st = id == 0 ? main.get() : helpers[id - 1].get();
+            }
+
+            if (id == 0 && print_info){
+                iterative_deepening<true>(*st);
+            }
+            else {
+                iterative_deepening<false>(*st);
+            }
+
+            std::lock_guard lock(mutex);
+            if (--searching == 0){
+                finished.notify_all();
+            }
+        }
+    }
+
+    // Creates the parked threads for the current thread count, every thread
+    // builds its own SearchThread and this waits until all of them exist
+    void spawn(){
+        helpers.resize(thread_count - 1);
+        ready = 0;
+
+        for (ThreadCount i = 0; i < thread_count; i++){
+            threads.emplace_back(&ThreadHandler::idle_loop, this, i, generation);
+        }
+
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&]{ return ready == thread_count; });
+    }
+
+    void destroy(){
         stop();
+
+        {
+            std::lock_guard lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+
+        for (auto& th : threads){
+            th.join();
+        }
+
+        threads.clear();
+        helpers.clear();
+        main.reset();
+        quit = false;
     }
 
-    void resize(ThreadCount thread_count){
-        this->thread_count = std::max<ThreadCount>(1, thread_count);
+    public:
+    ~ThreadHandler(){
+        if (info){
+            info->stopped = true;
+        }
+
+        destroy();
+    }
+
+    // Threads are pinned when they are created, a new NumaPolicy applies from the next search on
+    void rebind(){
+        destroy();
     }
 
-    void start(SearchThread& searchThread){
+    void resize(int count){
+        ThreadCount new_count = std::clamp(count, 1, MAXTHREADS);
+
+        if (new_count != thread_count){
+            destroy();
+            thread_count = new_count;
+        }
+    }
+
+    void start(SearchThread& searchThread, bool print = true){
         stop();
 
-        // start search
-        threads.emplace_back(iterative_deepening<true>, std::ref(searchThread));
+        print_info = print;
+
+        info = &searchThread.info;
+
+        if (threads.empty()){
+            spawn();
+        }
+
+        // The main search runs on thread 0's own SearchThread, from the
+        // caller's position, clock and table
+        main->board = searchThread.board;
+        main->tm = searchThread.tm;
+        main->tt = searchThread.tt;
+
+        // Fathom's root probe isn't thread safe, so it runs once here and
+        // every thread searches the same DTZ filtered root moves
+        main->root_moves.size = 0;
+        if (Syzygy::Largest){
+            Syzygy::probe_root(main->board, main->root_moves);
+        }
+
+        // Lazy SMP helpers start from the main thread's position
+        for (auto& helper : helpers){
+            helper->board = main->board;
+            helper->root_moves = main->root_moves;
+            info->workers.push_back(helper.get());
+        }
+
+        info->active_workers = thread_count - 1;
+
+        {
+            std::lock_guard lock(mutex);
+            searching = thread_count;
+            generation++;
+        }
+        wake.notify_all();
+    }
+
+    bool searching_now(){
+        std::lock_guard lock(mutex);
+        return searching != 0;
     }
 
+    // Blocks until the current search, if any, has finished
     void stop(){
-        for (auto& th : threads){
-            if (th.joinable()){
-                th.join();
-            }
+        std::unique_lock lock(mutex);
+        finished.wait(lock, [&]{ return searching == 0; });
+
+        if (info){
+            info->workers.clear();
         }
+    }
 
-        searchers.clear();
-        threads.clear();
+    // Sums a per thread counter of the last search over the main thread and the helpers
+    uint64_t sum(uint64_t SearchThread::*counter) const {
+        uint64_t total = main ? (*main).*counter : 0;
+
+        for (auto& helper : helpers){
+            total += (*helper).*counter;
+        }
+
+        return total;
     }
-};
\ No newline at end of file
+
+    // Search statistics of the last search, summed like the counters above
+    SearchStats stats() const {
+        SearchStats total;
+
+        if (main){
+            total += main->stats;
+        }
+
+        for (auto& helper : helpers){
+            total += helper->stats;
+        }
+
+        return total;
+    }
+
+    // New game, the pool threads forget their histories as well
+    void clear(){
+        stop();
+
+        if (main){
+            main->clear();
+        }
+
+        for (auto& helper : helpers){
+            helper->clear();
+        }
+    }
+
+    // After a net switch, the pool threads' cached accumulators still hold the old weights
+    void reset_refresh_caches(){
+        stop();
+
+        if (main){
+            main->nnue.reset_refresh_cache();
+        }
+
+        for (auto& helper : helpers){
+            helper->nnue.reset_refresh_cache();
+        }
+    }
+};
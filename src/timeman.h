@@ -1,7 +1,11 @@
 #pragma once
 
+#include "misc.h"
 #include "types.h"
+
+#include <algorithm>
 #include <cmath>
+#include <vector>
 
 struct TimeMan {
     int movestogo = -1;
@@ -20,10 +24,20 @@ struct TimeMan {
     Time stoptime_opt{};
     Time average_time{};
 
+    // start_time + stoptime, compared against the coarse clock
+    int64_t deadline_max{};
+    int64_t deadline_opt{};
+
     int stability{};
 
     Move prev_bestmove{NO_MOVE};
 
+    // Nodes the main thread spent below every root move (by from and to square)
+    std::vector<uint64_t> root_nodes;
+
+    // How far the last iteration's score fell below the one before, set by the aspiration window
+    int score_drop{};
+
     void set_time(Color side) {
         constexpr int safety_overhead = 50;
         Time uci_time = (side == White ? wtime : btime);
@@ -55,13 +69,30 @@ struct TimeMan {
             movetime -= safety_overhead;
             stoptime_max = stoptime_opt = average_time = movetime;
         }
+
+        root_nodes.assign(64 * 64, 0);
+        score_drop = 0;
+        set_deadlines();
     }
 
-    bool check_time() { return (misc::tick() > (start_time + stoptime_max)); }
+    void set_deadlines() {
+        deadline_max = static_cast<int64_t>(start_time + stoptime_max);
+        deadline_opt = static_cast<int64_t>(start_time + stoptime_opt);
+    }
 
-    bool stop_search() { return (misc::tick() > (start_time + stoptime_opt)); }
+    bool check_time() { return misc::coarse_tick() > deadline_max; }
 
-    void update_tm(Move bestmove) {
+    bool stop_search() { return misc::coarse_tick() > deadline_opt; }
+
+    void add_root_nodes(Move move, uint64_t nodes) {
+        if (!root_nodes.empty()) {
+            root_nodes[from(move) * 64 + to(move)] += nodes;
+        }
+    }
+
+    /// @param total_nodes nodes the main thread searched so far
+    /// @param depth the completed depth, the node fraction is too noisy in the first iterations
+    void update_tm(Move bestmove, uint64_t total_nodes, int depth) {
 
         // Stability scale from Stash
         constexpr double stability_scale[5] = {2.50, 1.20, 0.90, 0.80, 0.75};
@@ -75,11 +106,24 @@ struct TimeMan {
 
         double scale = stability_scale[stability];
 
+        // Spend less when most of the tree went into the best move, more when
+        // the alternatives needed as much work
+        if (depth >= 6 && total_nodes && !root_nodes.empty()) {
+            const double fraction = double(root_nodes[from(bestmove) * 64 + to(bestmove)]) / total_nodes;
+            scale *= (1.5 - fraction) * 1.35;
+        }
+
+        // and more after the score dropped
+        scale *= std::clamp(1.0 + score_drop / 100.0, 1.0, 1.5);
+
         stoptime_opt = std::min<Time>(stoptime_max, average_time * scale);
+        set_deadlines();
     }
 
     void reset() {
         stability = 0;
+        score_drop = 0;
         prev_bestmove = NO_MOVE;
+        root_nodes.clear();
     }
 };
\ No newline at end of file
@@ -1,17 +1,147 @@
 #include "tt.h"
 
-void TranspositionTable::Initialize(int MB)
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+/* Allocates the table aligned to the huge page size and asks the OS to back it
+ * with huge pages, so TT probes don't thrash the TLB. Falls back to normal
+ * pages when huge pages aren't available. */
+static void *aligned_large_alloc(uint64_t &size)
+{
+#if defined(_WIN32)
+    void *mem = nullptr;
+    const SIZE_T large_page = GetLargePageMinimum();
+
+    if (large_page)
+    {
+        SIZE_T large_size = ((size + large_page - 1) / large_page) * large_page;
+        mem = VirtualAlloc(nullptr, large_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+        if (mem)
+        {
+            size = large_size;
+            return mem;
+        }
+    }
+
+    return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+#if defined(__linux__)
+    constexpr uint64_t alignment = 2 * 1024 * 1024;
+#else
+    constexpr uint64_t alignment = 4096;
+#endif
+    size = ((size + alignment - 1) / alignment) * alignment;
+    void *mem = std::aligned_alloc(alignment, size);
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if (mem)
+    {
+        madvise(mem, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    return mem;
+#endif
+}
+
+static void aligned_large_free(void *mem)
+{
+#if defined(_WIN32)
+    if (mem)
+    {
+        VirtualFree(mem, 0, MEM_RELEASE);
+    }
+#else
+    std::free(mem);
+#endif
+}
+
+TranspositionTable::~TranspositionTable()
+{
+    free_buckets();
+}
+
+void TranspositionTable::free_buckets()
+{
+    aligned_large_free(buckets);
+
+    buckets = nullptr;
+    bucket_count = 0;
+    allocated_size = 0;
+}
+
+bool TranspositionTable::allocate(uint64_t count)
+{
+    // Only reallocate when the size actually changes
+    if (count == bucket_count)
+    {
+        return true;
+    }
+
+    free_buckets();
+
+    uint64_t size = count * sizeof(TTBucket);
+    buckets = static_cast<TTBucket *>(aligned_large_alloc(size));
+
+    if (!buckets)
+    {
+        return false;
+    }
+
+    bucket_count = count;
+    allocated_size = size;
+
+    return true;
+}
+
+void TranspositionTable::Initialize(int MB, int threads)
 {
-    clear();
-    this->entries.resize((MB * 1024 * 1024) / sizeof(TTEntry), TTEntry());
-    std::fill(entries.begin(), entries.end(), TTEntry());
+    const uint64_t count = (static_cast<uint64_t>(MB) * 1024 * 1024) / sizeof(TTBucket);
+
+    if (!allocate(count))
+    {
+        std::cout << "info string Failed to allocate " << MB << "MB for the transposition table" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
-    std::cout << "Transposition Table Initialized with " << entries.size() << " entries (" << MB << "MB)" << std::endl;
+    clear(threads);
+
+    std::cout << "Transposition Table Initialized with " << bucket_count * TT_BUCKET_SIZE << " entries (" << MB << "MB)" << std::endl;
 }
 
 void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int score, int eval, int ply, bool pv)
 {
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
+    TTBucket& b = bucket(key);
+    TTEntry* replace_entry = &b.entries[0];
+
+    // Reuse the slot of the same position if we have one, otherwise replace
+    // the entry that is the shallowest and oldest in the bucket.
+    for (int i = 0; i < TT_BUCKET_SIZE; i++)
+    {
+        TTEntry& entry = b.entries[i];
+
+        if (!entry.key || entry.key == tt_key(key))
+        {
+            replace_entry = &entry;
+            break;
+        }
+
+        if (entry.depth - 4 * relativeAge(entry) < replace_entry->depth - 4 * relativeAge(*replace_entry))
+        {
+            replace_entry = &entry;
+        }
+    }
+
+    TTEntry& entry = *replace_entry;
 
     bool replace = false;
 
@@ -21,14 +151,14 @@ void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int
         return;
     }
 
-    if (move || static_cast<TTKey>(key) != entry.key)
+    if (move || tt_key(key) != entry.key)
     {
         entry.move = move;
     }
 
-    if (f == HFEXACT || static_cast<TTKey>(key) != entry.key || depth + 4 > entry.depth)
+    if (f == HFEXACT || tt_key(key) != entry.key || depth + 4 > entry.depth)
     {
-        entry.key = static_cast<TTKey>(key);
+        entry.key = tt_key(key);
         entry.flag = f;
         entry.move = move;
         entry.depth = depth;
@@ -40,29 +170,171 @@ void TranspositionTable::store(U64 key, uint8_t f, Move move, uint8_t depth, int
 
 TTEntry& TranspositionTable::probe_entry(U64 key, bool& ttHit, int ply)
 {
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
+    TTBucket& b = bucket(key);
+    TTEntry* replace_entry = &b.entries[0];
 
-    ttHit = (static_cast<TTKey>(key) == entry.key);
+    for (int i = 0; i < TT_BUCKET_SIZE; i++)
+    {
+        TTEntry& entry = b.entries[i];
+
+        if (entry.key == tt_key(key))
+        {
+            ttHit = true;
+            return entry;
+        }
+
+        if (entry.depth - 4 * relativeAge(entry) < replace_entry->depth - 4 * relativeAge(*replace_entry))
+        {
+            replace_entry = &entry;
+        }
+    }
+
+    ttHit = false;
 
-    return entry;
+    return *replace_entry;
 }
 
 Move TranspositionTable::probeMove(U64 key){
-    TTEntry& entry = entries[reduce_hash(key, entries.size())];
+    TTBucket& b = bucket(key);
 
-    if (static_cast<TTKey>(key) == entry.key){
-        return entry.move;
+    for (int i = 0; i < TT_BUCKET_SIZE; i++)
+    {
+        if (tt_key(key) == b.entries[i].key){
+            return b.entries[i].move;
+        }
     }
 
     return NO_MOVE;
 }
 
 void TranspositionTable::prefetch_tt(const U64 key){
-    prefetch(&(entries[reduce_hash(key, entries.size())]));
+    prefetch(&bucket(key));
 }
 
-void TranspositionTable::clear()
+/* Zeroes the table in place, split across threads so large tables get
+ * cleared quickly between games. */
+void TranspositionTable::clear(int threads)
 {
     currentAge = 0;
-    entries.clear();
-}
\ No newline at end of file
+
+    threads = std::max(1, threads);
+
+    std::vector<std::thread> workers;
+    const uint64_t chunk = allocated_size / threads;
+
+    for (int i = 0; i < threads; i++)
+    {
+        const uint64_t start = chunk * i;
+        const uint64_t length = (i == threads - 1) ? allocated_size - start : chunk;
+
+        workers.emplace_back([this, start, length]() {
+            std::memset(reinterpret_cast<char *>(buckets) + start, 0, length);
+        });
+    }
+
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+/* A saved table starts with this header. The layout fields reject files
+ * written by a build whose entries or buckets look different. */
+struct TTFileHeader
+{
+    char magic[8] = {'R', 'I', 'C', 'E', 'H', 'A', 'S', 'H'};
+    uint32_t version = 1;
+    uint16_t entry_size = sizeof(TTEntry);
+    uint16_t bucket_entries = TT_BUCKET_SIZE;
+    uint32_t bucket_size = sizeof(TTBucket);
+    uint32_t age = 0;
+    uint64_t bucket_count = 0;
+};
+
+// Tables are written and read in large sequential chunks
+static constexpr uint64_t TT_IO_CHUNK = 64ull * 1024 * 1024;
+
+bool TranspositionTable::save(const std::string &file) const
+{
+    std::ofstream out(file, std::ios::binary);
+    if (!out)
+    {
+        return false;
+    }
+
+    TTFileHeader header;
+    header.age = currentAge;
+    header.bucket_count = bucket_count;
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    const char *data = reinterpret_cast<const char *>(buckets);
+    const uint64_t size = bucket_count * sizeof(TTBucket);
+
+    for (uint64_t done = 0; done < size && out; done += TT_IO_CHUNK)
+    {
+        out.write(data + done, std::min(TT_IO_CHUNK, size - done));
+    }
+
+    return bool(out);
+}
+
+bool TranspositionTable::load(const std::string &file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+
+    TTFileHeader header, expected;
+    in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+    if (!in || std::memcmp(header.magic, expected.magic, sizeof(header.magic)) || header.version != expected.version ||
+        header.entry_size != expected.entry_size || header.bucket_entries != expected.bucket_entries ||
+        header.bucket_size != expected.bucket_size || !header.bucket_count)
+    {
+        return false;
+    }
+
+    // Check the header against the limit and the file before the current table is freed
+    const uint64_t max_buckets = uint64_t(MAXHASH) * 1024 * 1024 / sizeof(TTBucket);
+    if (header.bucket_count > max_buckets)
+    {
+        return false;
+    }
+
+    const auto payload_start = in.tellg();
+    in.seekg(0, std::ios::end);
+    const uint64_t payload_size = uint64_t(in.tellg() - payload_start);
+    in.seekg(payload_start);
+
+    if (!in || payload_size != header.bucket_count * sizeof(TTBucket))
+    {
+        return false;
+    }
+
+    if (!allocate(header.bucket_count))
+    {
+        return false;
+    }
+
+    char *data = reinterpret_cast<char *>(buckets);
+    const uint64_t size = bucket_count * sizeof(TTBucket);
+
+    for (uint64_t done = 0; done < size && in; done += TT_IO_CHUNK)
+    {
+        in.read(data + done, std::min(TT_IO_CHUNK, size - done));
+    }
+
+    if (!in)
+    {
+        // A truncated file leaves a partly filled table, start from an empty one instead
+        clear();
+        return false;
+    }
+
+    currentAge = header.age & 63;
+
+    return true;
+}
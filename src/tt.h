@@ -2,19 +2,28 @@
 
 #include "types.h"
 
-// 8192 MBS
-#define MAXHASH 8192
+#include <string>
+
+// 256 GBS
+#define MAXHASH 262144
 
 using TTKey = uint16_t;
 
+// The bucket index comes from the upper bits of the hash (see reduce_hash),
+// so the verification key uses the lower bits which barely affect the index.
+static inline TTKey tt_key(U64 key) { return static_cast<TTKey>(key); }
+
+// 6 entries of 10 bytes fill one 64 byte cache line
+#define TT_BUCKET_SIZE 6
+
 enum : uint8_t { HFNONE, HFBETA, HFALPHA, HFEXACT };
 
 struct TTEntry {
     int16_t score = 0;
     int16_t eval = 0;
 
-    uint8_t flag : 2;
-    uint8_t age : 6;
+    uint8_t flag : 2 = HFNONE;
+    uint8_t age : 6 = 0;
 
     uint8_t depth = 0;
 
@@ -30,22 +39,56 @@ struct TTEntry {
     }
 };
 
+struct alignas(64) TTBucket {
+    TTEntry entries[TT_BUCKET_SIZE];
+};
+
+static_assert(sizeof(TTEntry) == 10, "TTEntry must stay 10 bytes");
+static_assert(sizeof(TTBucket) == 64, "TTBucket must fill a single cache line");
+
 class TranspositionTable {
   private:
-    std::vector<TTEntry> entries;
+    TTBucket *buckets = nullptr;
+    uint64_t bucket_count = 0;
+    uint64_t allocated_size = 0;
+
+    TTBucket &bucket(U64 key) {
+      return buckets[reduce_hash(key, bucket_count)];
+    }
+
+    void free_buckets();
+    bool allocate(uint64_t count);
 
   public:
     uint8_t currentAge = 0;
 
-    void Initialize(int usersize);
+    TranspositionTable() = default;
+    TranspositionTable(const TranspositionTable &) = delete;
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+    ~TranspositionTable();
+
+    void Initialize(int usersize, int threads = 1);
     void store(U64 key, uint8_t f, Move move, uint8_t depth, int score, int eval, int ply, bool pv);
     TTEntry &probe_entry(U64 key, bool &ttHit, int ply);
     Move probeMove(U64 key);
     void prefetch_tt(const U64 key);
-    void clear();
+    void clear(int threads = 1);
 
+    // Writes the table with its layout and age to a file, load resizes the table to the saved size
+    bool save(const std::string &file) const;
+    bool load(const std::string &file);
+
+    int size_mb() const {
+      return static_cast<int>(bucket_count * sizeof(TTBucket) / (1024 * 1024));
+    }
+
+    // Age is stored in 6 bits, so it wraps around instead of saturating
     void nextAge(){
-      currentAge = std::min<uint8_t>(currentAge + 1, 63);
+      currentAge = (currentAge + 1) & 63;
+    }
+
+    int relativeAge(const TTEntry &entry) const {
+      return (currentAge - entry.age) & 63;
     }
 };
 
@@ -17,6 +17,8 @@ enum Score : int{
     KNOWN_WIN = 10000,
     IS_MATE_IN_MAX_PLY = (ISMATE - MAXPLY),
     IS_MATED_IN_MAX_PLY = -IS_MATE_IN_MAX_PLY,
+    // tablebase wins rank below every mate the search can find
+    TB_WIN_SCORE = IS_MATE_IN_MAX_PLY - MAXPLY - 1,
     INF_BOUND = 30001,
     VALUE_NONE = 32002,
 };
@@ -35,7 +37,25 @@ typedef double Time;
 
 static inline bool is_capture(Board &board, Move move) { return (board.pieceAtB(to(move)) != None); }
 
-static inline uint32_t reduce_hash(uint32_t x, uint32_t N) { return ((uint64_t)x * (uint64_t)N) >> 32; }
+// Maps a 64 bit hash onto [0, N) using the high half of the 128 bit product,
+// so the index is taken from the upper bits of the key.
+static inline uint64_t reduce_hash(uint64_t x, uint64_t N) {
+#if defined(__SIZEOF_INT128__)
+    return static_cast<uint64_t>((static_cast<__uint128_t>(x) * static_cast<__uint128_t>(N)) >> 64);
+#elif defined(_MSC_VER) && defined(_WIN64)
+    return __umulh(x, N);
+#else
+    uint64_t x_lo = static_cast<uint32_t>(x), x_hi = x >> 32;
+    uint64_t n_lo = static_cast<uint32_t>(N), n_hi = N >> 32;
+
+    uint64_t lo_lo = x_lo * n_lo;
+    uint64_t hi_lo = x_hi * n_lo;
+    uint64_t lo_hi = x_lo * n_hi;
+    uint64_t cross = (lo_lo >> 32) + static_cast<uint32_t>(hi_lo) + lo_hi;
+
+    return x_hi * n_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
 
 
 enum {
@@ -1,9 +1,16 @@
 #include "uci.h"
+#include "analyse.h"
 #include "bench.h"
+#include "datagen.h"
 #include "eval.h"
+#include "evalbatch.h"
 #include "misc.h"
+#include "numa.h"
 #include "movescore.h"
+#include "perft.h"
+#include "microbench.h"
 #include "search.h"
+#include "syzygy.h"
 #include "tt.h"
 #include "types.h"
 #include "thread.h"
@@ -28,7 +35,13 @@ static void uci_send_id() {
     std::cout << "id name " << NAME << std::endl;
     std::cout << "id author " << AUTHOR << std::endl;
     std::cout << "option name Hash type spin default 64 min 4 max " << MAXHASH << std::endl;
-    std::cout << "option name Threads type spin default 1 min 1 max 1" << std::endl;
+    std::cout << "option name Threads type spin default 1 min 1 max " << MAXTHREADS << std::endl;
+    std::cout << "option name EvalFile type string default <embedded>" << std::endl;
+    std::cout << "option name Ponder type check default false" << std::endl;
+    std::cout << "option name NumaPolicy type combo default auto var auto var pin var none" << std::endl;
+    std::cout << "option name SyzygyPath type string default <empty>" << std::endl;
+    std::cout << "option name SyzygyProbeDepth type spin default 1 min 1 max 100" << std::endl;
+    std::cout << "option name SyzygyProbeLimit type spin default 7 min 0 max 7" << std::endl;
 
     if (TUNING) {
         print_tuning_parameters();
@@ -50,6 +63,8 @@ int DefaultHashSize = 64;
 int CurrentHashSize = DefaultHashSize;
 int LastHashSize = CurrentHashSize;
 
+int ThreadCount = 1;
+
 bool IsUci = false;
 
 TranspositionTable *table;
@@ -59,20 +74,76 @@ void uci_loop(int argv, char **argc) {
 
     SearchInfo info;
 
-    auto searchThread = std::make_unique<SearchThread>(info);
-
     auto ttable = std::make_unique<TranspositionTable>();
     table = ttable.get();
     table->Initialize(DefaultHashSize);
 
+    auto searchThread = std::make_unique<SearchThread>(info);
+
     if (argv > 1 && std::string{argc[1]} == "bench") {
-        info.depth = 13;
-        info.timeset = false;
-        StartBenchmark(*searchThread);
+        // Rice bench [depth] [threads] [hash] [fenfile] [json]
+        std::string args;
+        for (int i = 2; i < argv; i++) {
+            args += std::string{argc[i]} + " ";
+        }
+
+        std::istringstream is(args);
+        StartBenchmark(*searchThread, ParseBenchOptions(is));
         exit(0);
     }else if (argv > 1 && std::string{argc[1]} == "nn-bench") {
         searchThread->nnue.Benchmark();
         exit(0);
+    } else if (argv > 1 && std::string{argc[1]} == "microbench") {
+        // Rice microbench [hash], the size of the large TT in MB
+        StartMicroBench(argv > 2 ? std::clamp(std::stoi(argc[2]), 1, MAXHASH) : 1024);
+        exit(0);
+    } else if (argv > 3 && std::string{argc[1]} == "nn-pack") {
+        exit(NNUE::PackFile(argc[2], argc[3]) ? 0 : 1);
+    } else if (argv > 1 && std::string{argc[1]} == "analyse") {
+        AnalyseOptions options;
+        if (!ParseAnalyseOptions(argv - 1, argc + 1, options)) {
+            std::cout << "usage: Rice analyse <file.epd> [--depth N] [--nodes N] [--threads T] [--hash H] "
+                         "[--private-tt] [--keep-history] [--out file.csv]"
+                      << std::endl;
+            exit(1);
+        }
+
+        StartAnalysis(options);
+        exit(0);
+    } else if (argv > 1 && std::string{argc[1]} == "datagen") {
+        DatagenOptions options;
+        if (!ParseDatagenOptions(argv - 1, argc + 1, options)) {
+            std::cout << "usage: Rice datagen <out.bin> [--threads T] [--nodes N] [--positions N] "
+                         "[--random-plies P] [--hash H]"
+                      << std::endl;
+            exit(1);
+        }
+
+        StartDatagen(options);
+        exit(0);
+    } else if (argv > 1 && std::string{argc[1]} == "evalbatch") {
+        EvalBatchOptions options;
+        if (!ParseEvalBatchOptions(argv - 1, argc + 1, options)) {
+            std::cout << "usage: Rice evalbatch <in> <out> [--threads T] [--format fen|packed]" << std::endl;
+            exit(1);
+        }
+
+        StartEvalBatch(options);
+        exit(0);
+    } else if (argv > 2 && (std::string{argc[1]} == "perft" || std::string{argc[1]} == "divide")) {
+        // Rice perft <depth> [threads] [hash] [fen]
+        std::string fen;
+        for (int i = 5; i < argv; i++) {
+            fen += (i > 5 ? " " : "") + std::string{argc[i]};
+        }
+
+        if (!fen.empty()) {
+            searchThread->applyFen(fen);
+        }
+
+        StartPerft(searchThread->board, std::stoi(argc[2]), argv > 3 ? std::stoi(argc[3]) : 1,
+                   argv > 4 ? std::stoi(argc[4]) : 0, std::string{argc[1]} == "divide");
+        exit(0);
     }
 
     ThreadHandler threadHandle;
@@ -87,10 +158,17 @@ void uci_loop(int argv, char **argc) {
         is >> std::skipws >> token;
 
         if (token == "stop") {
+            info.ponder = false;
             info.stopped = true;
             threadHandle.stop();
 
+        } else if (token == "ponderhit") {
+            // The search keeps running, its clock now counts from the ponder start
+            info.ponder = false;
+            continue;
+
         } else if (token == "quit") {
+            info.ponder = false;
             info.stopped = true;
             threadHandle.stop();
 
@@ -101,7 +179,9 @@ void uci_loop(int argv, char **argc) {
             continue;
 
         } else if (token == "ucinewgame") {
-            table->Initialize(CurrentHashSize);
+            threadHandle.clear();
+            searchThread->clear();
+            table->clear(ThreadCount);
             continue;
 
         } else if (token == "uci") {
@@ -169,8 +249,19 @@ void uci_loop(int argv, char **argc) {
 
             uint64_t nodes = -1;
 
+            bool ponder = false;
+            bool infinite = false;
+
             while (token != "none") {
+                if (token == "ponder") {
+                    ponder = true;
+                    if (!(is >> std::skipws >> token)) {
+                        token = "none";
+                    }
+                    continue;
+                }
                 if (token == "infinite") {
+                    infinite = true;
                     depth = -1;
                     break;
                 }
@@ -246,6 +337,8 @@ void uci_loop(int argv, char **argc) {
             }
 
             info.stopped = false;
+            info.ponder = ponder;
+            info.infinite = infinite;
             info.uci = IsUci;
 
             threadHandle.start(*searchThread);
@@ -256,6 +349,52 @@ void uci_loop(int argv, char **argc) {
             is >> std::skipws >> token;
 
             set_option(is, token, "Hash", CurrentHashSize);
+            set_option(is, token, "Threads", ThreadCount);
+
+            if (token == "EvalFile") {
+                std::string file_name;
+                is >> std::skipws >> token;
+                std::getline(is >> std::ws, file_name);
+
+                // A running search still reads the weights the switch unmaps
+                if (threadHandle.searching_now()) {
+                    std::cout << "info string EvalFile can only be changed while the engine is idle" << std::endl;
+                    continue;
+                }
+
+                if (file_name.empty() || file_name == "<embedded>") {
+                    NNUE::LoadEmbedded();
+                } else {
+                    NNUE::LoadFile(file_name);
+                }
+
+                // Cached accumulators were built from the previous weights
+                threadHandle.reset_refresh_caches();
+                searchThread->nnue.reset_refresh_cache();
+                searchThread->board.refresh(searchThread->nnue);
+            }
+
+            if (token == "NumaPolicy") {
+                is >> std::skipws >> token;
+                is >> std::skipws >> token;
+
+                if (Numa::set_policy(token)) {
+                    threadHandle.rebind();
+                    std::cout << "info string " << Numa::nodes().size() << " NUMA node(s), NumaPolicy " << token
+                              << std::endl;
+                }
+            }
+
+            if (token == "SyzygyPath") {
+                std::string path;
+                is >> std::skipws >> token;
+                std::getline(is >> std::ws, path);
+
+                Syzygy::init(path);
+            }
+
+            set_option(is, token, "SyzygyProbeDepth", Syzygy::ProbeDepth);
+            set_option(is, token, "SyzygyProbeLimit", Syzygy::ProbeLimit);
 
             // Tuner related options
             set_option(is, token, "RFPMargin", RFPMargin);
@@ -271,10 +410,12 @@ void uci_loop(int argv, char **argc) {
 
             init_search();
 
+            threadHandle.resize(ThreadCount);
+
             if (CurrentHashSize != LastHashSize) {
                 CurrentHashSize = std::min(CurrentHashSize, MAXHASH);
                 LastHashSize = CurrentHashSize;
-                table->Initialize(CurrentHashSize);
+                table->Initialize(CurrentHashSize, ThreadCount);
             }
         }
 
@@ -310,16 +451,62 @@ void uci_loop(int argv, char **argc) {
 
             std::cout << (searchThread->board.sideToMove == White ? "White" : "Black") << std::endl;
 
+        } else if (token == "perft" || token == "divide") {
+            // perft <depth> [threads] [hash], threads default to the Threads option
+            int depth = 1;
+            int threads = ThreadCount;
+            int hash = 0;
+            is >> depth >> threads >> hash;
+
+            StartPerft(searchThread->board, depth, threads, hash, token == "divide");
+
+        } else if (token == "savehash" || token == "loadhash") {
+            std::string file;
+            std::getline(is >> std::ws, file);
+
+            if (file.empty() || threadHandle.searching_now()) {
+                std::cout << "info string " << token << " needs a file and an idle engine" << std::endl;
+                continue;
+            }
+
+            if (token == "savehash") {
+                const bool saved = table->save(file);
+                std::cout << "info string " << (saved ? "Saved hash to " : "Could not save hash to ") << file
+                          << std::endl;
+                continue;
+            }
+
+            if (!table->load(file)) {
+                std::cout << "info string Could not load hash from " << file << std::endl;
+
+                // The old table may be gone if the saved size could not be allocated
+                if (table->size_mb() == 0) {
+                    table->Initialize(CurrentHashSize, ThreadCount);
+                }
+                continue;
+            }
+
+            // The table takes the saved size, a resize would throw the entries away
+            CurrentHashSize = LastHashSize = table->size_mb();
+            std::cout << "info string Loaded " << CurrentHashSize << "MB hash from " << file << std::endl;
+
+        } else if (token == "stats") {
+            // Counters of the last search over all threads, needs STATS=yes
+            PrintSearchStats(threadHandle.stats(), threadHandle.sum(&SearchThread::nodes_reached),
+                             threadHandle.sum(&SearchThread::tt_probes), threadHandle.sum(&SearchThread::tt_hits));
+
         } else if (token == "bench") {
 
-            info.depth = 13;
-            info.timeset = false;
-            StartBenchmark(*searchThread);
+            BenchOptions options = ParseBenchOptions(is);
+            StartBenchmark(*searchThread, options);
+
+            // Give the search back the table size that the Hash option asked for
+            if (options.hash && options.hash != CurrentHashSize) {
+                table->Initialize(CurrentHashSize, ThreadCount);
+            }
         }
     }
 
-    table->clear();
-
     std::cout << std::endl;
     if (!info.uci) {
         std::cout << "\u001b[0m";